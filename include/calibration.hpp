@@ -0,0 +1,325 @@
+#ifndef HPP_CALIBRATION
+#define HPP_CALIBRATION
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+#include "counterrng.hpp"
+#include "hostmap.hpp"
+#include "parallel.hpp"
+
+/// <summary>
+/// Fits pathogen parameters to an observed epidemic curve by approximate
+/// Bayesian computation with sequential Monte Carlo (ABC-SMC).
+/// </summary>
+/// <remarks>
+/// <para>
+/// A population of parameter particles is drawn from uniform priors. Each
+/// generation proposes particles by perturbing the previous population with
+/// a Gaussian kernel (twice the weighted variance), simulates one replicate
+/// per proposal and accepts it if the distance between simulated and
+/// observed daily increments is within the tolerance. The tolerance of the
+/// next generation is a quantile of the accepted distances, so it tightens
+/// automatically. Weights follow Beaumont et al. (2009).
+/// </para>
+/// <para>
+/// The distance is the Euclidean norm of the daily differences, whose square
+/// only grows as days are added, so a simulation is stopped as soon as its
+/// partial distance exceeds the tolerance; a rejected proposal usually costs
+/// only a fraction of the observed period. An outbreak that dies out is
+/// finished at once, since its remaining increments are known to be zero.
+/// </para>
+/// <para>
+/// Proposals are simulated in parallel, one map per proposal, on the same
+/// worker pool as <c>Ensemble</c>; a generation ends once the population is
+/// filled by the lowest-numbered accepted proposals, or when its budget of
+/// proposals runs out.
+/// </para>
+/// </remarks>
+class AbcCalibration
+{
+public:
+    /// <summary>
+    /// Uniform prior of one parameter.
+    /// </summary>
+    struct Parameter
+    {
+        double lower;           ///< smallest value
+        double upper;           ///< largest value
+        bool integer = false;   ///< round proposals, e.g., for period parameters
+    };
+
+    /// <summary>
+    /// Accepted parameter values with their importance weight.
+    /// </summary>
+    struct Particle
+    {
+        std::vector<double> values;
+        double weight = 0.0;
+        double distance = 0.0;
+    };
+
+    /// <summary>
+    /// Initialize a calibration.
+    /// </summary>
+    /// <param name="priors">prior range of every parameter</param>
+    /// <param name="model">builds a pathogen from parameter values, in the order of <c>priors</c></param>
+    /// <param name="r">number of rows in each map</param>
+    /// <param name="c">number of columns in each map</param>
+    /// <param name="setup">prepares a freshly reset map, e.g., by seeding</param>
+    /// <param name="observed">observed daily increments (by default new infections per day)</param>
+    AbcCalibration(std::vector<Parameter> priors, std::function<Pathogen(std::vector<double> const&)> model,
+        int r, int c, std::function<void(HostMap&)> setup, std::vector<double> observed)
+        : priors(std::move(priors)), model(std::move(model)), rows(r), cols(c),
+        setup(std::move(setup)), observed(std::move(observed))
+    {}
+
+    /// <summary>
+    /// Set the cumulative count whose daily increments are compared with the data.
+    /// </summary>
+    /// <param name="f">cumulative count of a map (default: cumulative infections)</param>
+    void setObservable(std::function<double(HostMap const&)> f) { observable = std::move(f); }
+
+    /// <summary>Set the number of particles per generation (default 500).</summary>
+    void setPopulation(unsigned n) { population = std::max(n, 2u); }
+
+    /// <summary>Set the quantile of accepted distances used as the next tolerance (default 0.5).</summary>
+    void setQuantile(double q) { alpha = q; }
+
+    /// <summary>
+    /// Set the number of proposals in one generation after which it gives up.
+    /// </summary>
+    /// <param name="n">largest number of proposals (0, the default, for 100 times the population)</param>
+    /// <remarks>
+    /// Without a bound, a tolerance that no simulation can meet would make a
+    /// generation run forever; <c>step</c> returns false instead.
+    /// </remarks>
+    void setSimulationBudget(unsigned long long n) { budget = n; }
+
+    /// <summary>
+    /// Run one generation.
+    /// </summary>
+    /// <param name="workers">number of threads (0 for <c>workerCount()</c>)</param>
+    /// <returns>false if the budget ran out before the population was filled (the previous population is kept)</returns>
+    /// <remarks>
+    /// Proposals are numbered and draw their parameters from a stream keyed by
+    /// that number. The population is the first <c>population</c> accepted
+    /// proposals by number, and every proposal below the last of them is
+    /// finished, so slow (large-outbreak) simulations are not crowded out by
+    /// quick ones.
+    /// </remarks>
+    bool step(unsigned workers = 0)
+    {
+        workers = workers ? workers : workerCount();
+        bool first = particles.empty();
+        auto eps = first ? std::numeric_limits<double>::infinity() : nextTolerance();
+        auto limit = eps * eps;
+        auto sigma = first ? std::vector<double>() : kernelWidths();
+
+        std::vector<double> cumulative(particles.size());
+        double sum = 0;
+        for (size_t k = 0; k < particles.size(); ++k) cumulative[k] = sum += particles[k].weight;
+
+        auto stream = std::random_device{}();
+        std::map<unsigned long long, Particle> accepted;    // by proposal number
+        std::mutex mutex;
+        std::atomic<unsigned long long> next(0), cutoff(budget ? budget : 100ull * population);
+        std::atomic<unsigned long long> tried(0), days(0), killed(0);
+        parallelFor(0, workers, [&](size_t, size_t, unsigned) {
+            std::uniform_real_distribution<double> uniform;
+            std::normal_distribution<double> normal;
+            unsigned long long simulated = 0;
+            for (auto n = next++; n < cutoff; n = next++) {
+                CounterEngine rng(mixKey(stream, n));
+                Particle p;
+                if (first) {
+                    for (auto const& q : priors) p.values.push_back(round(q, q.lower + (q.upper - q.lower) * uniform(rng)));
+                }
+                else {
+                    auto pick = std::lower_bound(cumulative.begin(), cumulative.end(), sum * uniform(rng)) - cumulative.begin();
+                    auto const& parent = particles[std::min<size_t>(pick, particles.size() - 1)];
+                    for (size_t i = 0; i < priors.size(); ++i) p.values.push_back(round(priors[i], parent.values[i] + sigma[i] * normal(rng)));
+                    if (!inPrior(p.values)) continue;
+                }
+
+                ++tried;
+                double d2 = 0;
+                if (!simulate(p.values, limit, d2, simulated)) {
+                    ++killed;
+                    continue;
+                }
+                p.distance = std::sqrt(d2);
+                p.weight = first ? 1.0 : 1.0 / kernelMixture(p.values, sigma);
+                std::lock_guard<std::mutex> lock(mutex);
+                accepted.emplace(n, std::move(p));
+                if (accepted.size() > population) accepted.erase(std::prev(accepted.end()));
+                if (accepted.size() == population) {
+                    // Proposals past the last accepted one can no longer enter the population.
+                    auto last = accepted.rbegin()->first + 1, current = cutoff.load();
+                    while (last < current && !cutoff.compare_exchange_weak(current, last)) {}
+                }
+            }
+            days += simulated;
+        }, workers);
+
+        simulations += tried;
+        simulatedDays += days;
+        killedSimulations += killed;
+        if (accepted.size() < population) return false;
+
+        double total = 0;
+        for (auto const& e : accepted) total += e.second.weight;
+        particles.clear();
+        for (auto& e : accepted) {
+            e.second.weight /= total;
+            particles.push_back(std::move(e.second));
+        }
+        tolerances.push_back(eps);
+        return true;
+    }
+
+    /// <summary>
+    /// Run generations until a tolerance is reached.
+    /// </summary>
+    /// <param name="generations">largest number of generations</param>
+    /// <param name="target">stop once the tolerance is at most this distance</param>
+    /// <param name="workers">number of threads (0 for <c>workerCount()</c>)</param>
+    /// <returns>the number of generations completed by this call</returns>
+    unsigned run(unsigned generations, double target = 0.0, unsigned workers = 0)
+    {
+        unsigned g = 0;
+        while (g < generations && (tolerances.empty() || tolerances.back() > target) && step(workers)) ++g;
+        return g;
+    }
+
+    /// <summary>Current population, with normalized weights.</summary>
+    std::vector<Particle> const& posterior() const { return particles; }
+
+    /// <summary>Tolerance of every completed generation (infinite for the first).</summary>
+    std::vector<double> const& tolerance() const { return tolerances; }
+
+    /// <summary>Weighted posterior mean of a parameter.</summary>
+    double mean(size_t i) const
+    {
+        double m = 0;
+        for (auto const& p : particles) m += p.weight * p.values[i];
+        return m;
+    }
+
+    /// <summary>Effective sample size of the current population.</summary>
+    double effectiveSize() const
+    {
+        double s = 0;
+        for (auto const& p : particles) s += p.weight * p.weight;
+        return s > 0 ? 1.0 / s : 0.0;
+    }
+
+    /// <summary>Number of proposals simulated so far.</summary>
+    unsigned long long proposals() const { return simulations; }
+
+    /// <summary>Number of proposals stopped early because they exceeded the tolerance.</summary>
+    unsigned long long rejectedEarly() const { return killedSimulations; }
+
+    /// <summary>Number of days simulated so far, over every proposal.</summary>
+    unsigned long long days() const { return simulatedDays; }
+
+private:
+    static double round(Parameter const& q, double x) { return q.integer ? std::round(x) : x; }
+
+    bool inPrior(std::vector<double> const& v) const
+    {
+        for (size_t i = 0; i < priors.size(); ++i) {
+            if (v[i] < priors[i].lower || v[i] > priors[i].upper) return false;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Simulate the observed period for some parameter values.
+    /// </summary>
+    /// <returns>false as soon as the squared distance exceeds the limit</returns>
+    bool simulate(std::vector<double> const& values, double limit, double& d2, unsigned long long& simulated) const
+    {
+        HostMap map(model(values), rows, cols);
+        map.reset();
+        if (setup) setup(map);
+        auto prev = observable ? observable(map) : map.countCumulative();
+        for (size_t d = 0; d < observed.size(); ++d) {
+            double inc = 0;
+            if (map.countInfected() > 0) {
+                map.computeNext();
+                ++simulated;
+                auto now = observable ? observable(map) : map.countCumulative();
+                inc = now - prev;
+                prev = now;
+            }
+            d2 += (inc - observed[d]) * (inc - observed[d]);
+            if (d2 > limit) return false;
+        }
+        return true;
+    }
+
+    double nextTolerance() const
+    {
+        std::vector<double> d;
+        for (auto const& p : particles) d.push_back(p.distance);
+        auto k = std::min(d.size() - 1, static_cast<size_t>(alpha * d.size()));
+        std::nth_element(d.begin(), d.begin() + k, d.end());
+        return d[k];
+    }
+
+    std::vector<double> kernelWidths() const
+    {
+        std::vector<double> sigma;
+        for (size_t i = 0; i < priors.size(); ++i) {
+            auto m = mean(i);
+            double v = 0;
+            for (auto const& p : particles) v += p.weight * (p.values[i] - m) * (p.values[i] - m);
+            auto floor = priors[i].integer ? 0.5 : 1e-3 * (priors[i].upper - priors[i].lower);
+            sigma.push_back(std::max(std::sqrt(2 * v), floor));
+        }
+        return sigma;
+    }
+
+    /// <summary>Density of a proposal under the perturbed previous population (up to a constant).</summary>
+    double kernelMixture(std::vector<double> const& v, std::vector<double> const& sigma) const
+    {
+        double s = 0;
+        for (auto const& p : particles) {
+            double e = 0;
+            for (size_t i = 0; i < v.size(); ++i) {
+                auto z = (v[i] - p.values[i]) / sigma[i];
+                e += z * z;
+            }
+            s += p.weight * std::exp(-0.5 * e);
+        }
+        return std::max(s, std::numeric_limits<double>::min());
+    }
+
+    std::vector<Parameter> priors;
+    std::function<Pathogen(std::vector<double> const&)> model;
+    int rows;
+    int cols;
+    std::function<void(HostMap&)> setup;
+    std::vector<double> observed;
+    std::function<double(HostMap const&)> observable;
+    unsigned population = 500;
+    double alpha = 0.5;
+    unsigned long long budget = 0;
+
+    std::vector<Particle> particles;
+    std::vector<double> tolerances;
+    unsigned long long simulations = 0;
+    unsigned long long killedSimulations = 0;
+    unsigned long long simulatedDays = 0;
+};
+
+#endif /*HPP_CALIBRATION*/
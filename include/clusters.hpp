@@ -0,0 +1,179 @@
+#ifndef HPP_CLUSTERS
+#define HPP_CLUSTERS
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <vector>
+#include "hostmap.hpp"
+#include "parallel.hpp"
+
+/// <summary>
+/// Sizes of the connected clusters of cells matching some condition.
+/// </summary>
+struct ClusterStats
+{
+    std::vector<int64_t> sizes;     ///< number of cells in each cluster, largest first
+
+    /// <summary>Number of clusters.</summary>
+    size_t count() const { return sizes.size(); }
+
+    /// <summary>Size of the largest cluster, or 0 if there are none.</summary>
+    int64_t largest() const { return sizes.empty() ? 0 : sizes.front(); }
+
+    /// <summary>Total number of cells in all clusters.</summary>
+    int64_t cells() const { return std::accumulate(sizes.begin(), sizes.end(), int64_t(0)); }
+
+    /// <summary>
+    /// Histogram of cluster sizes in powers of two.
+    /// </summary>
+    /// <returns>entry <c>b</c> counts clusters with size in <c>[2^b, 2^(b+1))</c></returns>
+    std::vector<int64_t> histogram() const
+    {
+        std::vector<int64_t> bins;
+        for (auto s : sizes) {
+            size_t b = 0;
+            while ((int64_t(2) << b) <= s) ++b;
+            if (bins.size() <= b) bins.resize(b + 1, 0);
+            ++bins[b];
+        }
+        return bins;
+    }
+};
+
+/// <summary>
+/// Label the 4-connected clusters of cells satisfying a condition, on the torus.
+/// </summary>
+/// <param name="map">a grid of hosts</param>
+/// <param name="member">condition on a host for its cell to belong to a cluster</param>
+/// <returns>the sizes of all clusters</returns>
+/// <remarks>
+/// <para>
+/// The grid is split into row bands that are labeled in parallel. Within a
+/// band, each row is reduced to runs of member cells and runs are joined by
+/// a union-find forest wherever they overlap a run of the previous row.
+/// The bands are then stitched together serially along their boundary rows,
+/// including the wrap from the last row to the first and from the last
+/// column to the first.
+/// </para>
+/// <para>
+/// Memory is proportional to the number of runs, not cells, so sparse
+/// outbreaks on very large grids are cheap to label.
+/// </para>
+/// </remarks>
+template <typename Member>
+ClusterStats findClusters(HostMap const& map, Member member)
+{
+    struct Run { int row, c0, c1; };   // cells [c0, c1) of a row
+
+    auto N = static_cast<int>(map.row_count());
+    auto M = static_cast<int>(map.col_count());
+    std::vector<std::vector<Run>> runs(workerCount());
+    std::vector<std::vector<int32_t>> parents(runs.size());
+    std::vector<std::pair<int, int>> bands(runs.size());
+
+    auto find = [](std::vector<int32_t>& p, int32_t x) {
+        while (p[x] != x) {
+            p[x] = p[p[x]];
+            x = p[x];
+        }
+        return x;
+    };
+    auto unite = [&](std::vector<int32_t>& p, int32_t a, int32_t b) {
+        a = find(p, a);
+        b = find(p, b);
+        if (a != b) p[std::max(a, b)] = std::min(a, b);
+    };
+
+    // Join the runs of two consecutive rows, [a0,a1) and [b0,b1) of the same list.
+    auto joinRows = [&](std::vector<Run> const& r, std::vector<int32_t>& p,
+        size_t a0, size_t a1, size_t b0, size_t b1) {
+        for (auto a = a0, b = b0; a < a1 && b < b1;) {
+            if (r[a].c0 < r[b].c1 && r[b].c0 < r[a].c1) unite(p, static_cast<int32_t>(a), static_cast<int32_t>(b));
+            if (r[a].c1 < r[b].c1) ++a; else ++b;
+        }
+    };
+
+    auto used = parallelFor(0, N, [&](size_t lo, size_t hi, unsigned w) {
+        auto& r = runs[w];
+        auto& p = parents[w];
+        r.clear();
+        size_t prev = 0, start = 0;
+        for (auto i = static_cast<int>(lo); i < static_cast<int>(hi); ++i) {
+            start = r.size();
+            auto const& row = map[i];
+            for (int j = 0; j < M;) {
+                if (!member(row[j])) { ++j; continue; }
+                auto c0 = j;
+                while (j < M && member(row[j])) ++j;
+                r.push_back({ i, c0, j });
+            }
+            auto end = r.size();
+            p.resize(end);
+            for (auto k = start; k < end; ++k) p[k] = static_cast<int32_t>(k);
+            // Horizontal wrap: a run touching the right edge meets one at the left edge.
+            if (end - start > 1 && r[start].c0 == 0 && r[end - 1].c1 == M) {
+                unite(p, static_cast<int32_t>(start), static_cast<int32_t>(end - 1));
+            }
+            if (i > static_cast<int>(lo)) joinRows(r, p, prev, start, start, end);
+            prev = start;
+        }
+        bands[w] = { static_cast<int>(lo), static_cast<int>(hi) };
+    });
+
+    // Stitch the bands into one forest over all runs.
+    std::vector<size_t> offset(used + 1, 0);
+    for (unsigned w = 0; w < used; ++w) offset[w + 1] = offset[w] + runs[w].size();
+    std::vector<Run> all;
+    std::vector<int32_t> p;
+    all.reserve(offset[used]);
+    p.reserve(offset[used]);
+    for (unsigned w = 0; w < used; ++w) {
+        all.insert(all.end(), runs[w].begin(), runs[w].end());
+        for (auto x : parents[w]) p.push_back(find(parents[w], x) + static_cast<int32_t>(offset[w]));
+    }
+
+    // Runs of a given row are contiguous; locate them by binary search on the row.
+    auto rowRange = [&](int i) {
+        auto lo = std::lower_bound(all.begin(), all.end(), i, [](Run const& x, int v) { return x.row < v; });
+        auto hi = std::lower_bound(lo, all.end(), i + 1, [](Run const& x, int v) { return x.row < v; });
+        return std::make_pair(static_cast<size_t>(lo - all.begin()), static_cast<size_t>(hi - all.begin()));
+    };
+    auto stitch = [&](int upper, int lower) {
+        auto a = rowRange(upper), b = rowRange(lower);
+        joinRows(all, p, a.first, a.second, b.first, b.second);
+    };
+    for (unsigned w = 1; w < used; ++w) stitch(bands[w].first - 1, bands[w].first);
+    if (N > 1) stitch(N - 1, 0);
+
+    // Total the cells under each root.
+    std::vector<int64_t> size(all.size(), 0);
+    for (size_t k = 0; k < all.size(); ++k) size[find(p, static_cast<int32_t>(k))] += all[k].c1 - all[k].c0;
+    ClusterStats stats;
+    for (auto s : size) {
+        if (s > 0) stats.sizes.push_back(s);
+    }
+    std::sort(stats.sizes.begin(), stats.sizes.end(), std::greater<int64_t>());
+    return stats;
+}
+
+/// <summary>
+/// Clusters of hosts with an active infection (exposed or infectious).
+/// </summary>
+/// <param name="map">a grid of hosts</param>
+inline ClusterStats infectedClusters(HostMap const& map)
+{
+    return findClusters(map, [](Host const& h) { return std::get<0>(h) == 1 || std::get<0>(h) == 2; });
+}
+
+/// <summary>
+/// Clusters of hosts that have ever been infected (active, recovered or deceased).
+/// </summary>
+/// <param name="map">a grid of hosts</param>
+inline ClusterStats affectedClusters(HostMap const& map)
+{
+    return findClusters(map, [](Host const& h) { return std::get<0>(h) >= 1 && std::get<0>(h) <= 5; });
+}
+
+#endif /*HPP_CLUSTERS*/
@@ -0,0 +1,105 @@
+#ifndef HPP_COMPARISON
+#define HPP_COMPARISON
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "ensemble.hpp"
+#include "stopping.hpp"
+
+/// <summary>
+/// Scalar outcome of every replicate, indexed by replicate.
+/// </summary>
+/// <remarks>
+/// Keeping one value per replicate (rather than running statistics) lets two
+/// ensembles run in paired mode be matched replicate by replicate.
+/// </remarks>
+class ReplicateOutcomes : public EnsembleCollector
+{
+public:
+    /// <summary>
+    /// Initialize with the outcome to record.
+    /// </summary>
+    /// <param name="outcome">value of interest at the end of a replicate, e.g., deaths</param>
+    explicit ReplicateOutcomes(std::function<double(HostMap const&)> outcome = [](HostMap const& m) {
+        return static_cast<double>(m.countCumulative());
+    })
+        : outcome(std::move(outcome))
+    {}
+
+    void prepare(unsigned, size_t, size_t) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        values.clear();
+        present.clear();
+    }
+
+    void replicateDone(HostMap const& map, unsigned replicate, unsigned) override
+    {
+        auto v = outcome(map);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (values.size() <= replicate) {
+            values.resize(replicate + 1, 0.0);
+            present.resize(replicate + 1, false);
+        }
+        values[replicate] = v;
+        present[replicate] = true;
+    }
+
+    /// <summary>
+    /// Outcome of a replicate.
+    /// </summary>
+    /// <param name="replicate">index of the replicate</param>
+    /// <returns>the recorded value, or NaN if that replicate did not complete</returns>
+    double at(unsigned replicate) const
+    {
+        return has(replicate) ? values[replicate] : std::nan("");
+    }
+
+    /// <summary>Indicates that a replicate completed.</summary>
+    bool has(unsigned replicate) const { return replicate < present.size() && present[replicate]; }
+
+    /// <summary>One past the highest replicate index recorded.</summary>
+    unsigned size() const { return static_cast<unsigned>(values.size()); }
+
+    /// <summary>Statistics of the outcome over the completed replicates.</summary>
+    RunningStats stats() const
+    {
+        RunningStats s;
+        for (unsigned r = 0; r < size(); ++r) {
+            if (has(r)) s.add(values[r]);
+        }
+        return s;
+    }
+
+private:
+    std::function<double(HostMap const&)> outcome;
+    std::vector<double> values;
+    std::vector<bool> present;
+    std::mutex mutex;
+};
+
+/// <summary>
+/// Statistics of the replicate-by-replicate difference between two ensembles.
+/// </summary>
+/// <param name="scenario">outcomes of the intervention ensemble</param>
+/// <param name="baseline">outcomes of the baseline ensemble, run with the same paired key</param>
+/// <returns>running statistics of <c>scenario - baseline</c> over replicates completed by both</returns>
+/// <remarks>
+/// With common random numbers the standard error of the mean difference is
+/// typically far below <c>sqrt(SE_a^2 + SE_b^2)</c> for independent runs.
+/// </remarks>
+inline RunningStats pairedDifference(ReplicateOutcomes const& scenario, ReplicateOutcomes const& baseline)
+{
+    RunningStats s;
+    auto n = std::min(scenario.size(), baseline.size());
+    for (unsigned r = 0; r < n; ++r) {
+        if (scenario.has(r) && baseline.has(r)) s.add(scenario.at(r) - baseline.at(r));
+    }
+    return s;
+}
+
+#endif /*HPP_COMPARISON*/
@@ -0,0 +1,533 @@
+#ifndef HPP_COMPARTMENTMODEL
+#define HPP_COMPARTMENTMODEL
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "counterrng.hpp"
+#include "forcing.hpp"
+#include "pathogen.hpp"
+#include "sampling.hpp"
+
+/// <summary>
+/// Compartment model described as data: states, dwell times, transition branches and infectiousness.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Each state has a dwell-time distribution (a probability mass function
+/// over whole days; an empty one makes the state absorbing), an
+/// infectiousness weight applied to the per-contact transmission
+/// probability, and up to <c>max_branches</c> outgoing transitions whose
+/// probabilities sum to one. Infection moves a host from the designated
+/// susceptible state to the designated entry state.
+/// </para>
+/// <para>
+/// <c>compile()</c> turns the description into dense tables: 32-bit
+/// cumulative branch thresholds (a branch is chosen by counting the
+/// thresholds a random word exceeds, without branching), a 256-entry inverse
+/// CDF of dwell times per state, and a 32-bit exposure threshold per state.
+/// </para>
+/// <para>
+/// Transmission and contact forcing, if set, are applied by <c>beginDay</c>,
+/// which <c>ModelMap</c> calls once per day: it rescales the exposure
+/// thresholds and the contact multiplier, so the per-host kernel is unchanged.
+/// </para>
+/// </remarks>
+class CompartmentModel
+{
+public:
+    /// <summary>Maximum number of transitions out of a single state.</summary>
+    static constexpr int max_branches = 4;
+
+    /// <summary>Number of quantiles in each dwell-time lookup table.</summary>
+    static constexpr int dwell_resolution = 256;
+
+    /// <summary>
+    /// Initialize an empty model.
+    /// </summary>
+    /// <param name="pE">probability of transmission per contact per day (at infectiousness 1)</param>
+    /// <param name="kT">average number of contacts per day</param>
+    CompartmentModel(double pE = 0.005, double kT = 16) : pE(pE), kT(kT) {}
+
+    /// <summary>
+    /// Add a state to the model.
+    /// </summary>
+    /// <param name="name">label for the state</param>
+    /// <param name="infectiousness">multiplier on <c>pE</c> for hosts in this state (0 if not infectious)</param>
+    /// <param name="dwell">probability of staying exactly <c>d</c> days, indexed by <c>d</c> (empty if absorbing)</param>
+    /// <returns>index of the new state</returns>
+    int addState(std::string const& name, float infectiousness = 0.0f,
+        std::vector<double> const& dwell = {})
+    {
+        if (states.size() >= 255) throw std::length_error("CompartmentModel: too many states");
+        states.push_back({ name, infectiousness, dwell, {} });
+        compiled = false;
+        return static_cast<int>(states.size()) - 1;
+    }
+
+    /// <summary>
+    /// Add a branch taken when a host's dwell time in a state runs out.
+    /// </summary>
+    /// <param name="from">index of the state being left</param>
+    /// <param name="to">index of the state being entered</param>
+    /// <param name="probability">probability of this branch</param>
+    void addTransition(int from, int to, double probability)
+    {
+        auto& branches = states.at(from).branches;
+        if (branches.size() >= max_branches) throw std::length_error("CompartmentModel: too many branches");
+        branches.push_back({ to, probability });
+        compiled = false;
+    }
+
+    /// <summary>
+    /// Designate the state infected hosts leave and the state they enter.
+    /// </summary>
+    /// <param name="from">the susceptible state</param>
+    /// <param name="to">the state entered upon infection</param>
+    void setInfection(int from, int to)
+    {
+        susceptible = from;
+        entry = to;
+        compiled = false;
+    }
+
+    /// <summary>
+    /// Make the transmission probability vary over time.
+    /// </summary>
+    /// <param name="f">multiplier on <c>pE</c> as a function of the day</param>
+    void setTransmissionForcing(Forcing f)
+    {
+        catchForcing = std::move(f);
+        if (compiled) beginDay(0);
+    }
+
+    /// <summary>
+    /// Make the contact intensity vary over time.
+    /// </summary>
+    /// <param name="f">multiplier on every host's contacts as a function of the day</param>
+    void setContactForcing(Forcing f)
+    {
+        contactForcing = std::move(f);
+        if (compiled) beginDay(0);
+    }
+
+    /// <summary>
+    /// Evaluate the forcings for a day into the exposure thresholds and contact multiplier.
+    /// </summary>
+    /// <param name="day">the simulation day about to be computed</param>
+    void beginDay(unsigned day)
+    {
+        auto f = catchForcing(day);
+        for (size_t s = 0; s < states.size(); ++s) {
+            exposure[s] = word(std::min(1.0, pE * f * states[s].infectiousness));
+        }
+        contactFactor = contactForcing(day);
+    }
+
+    /// <summary>
+    /// Dwell-time distribution of exactly <c>days</c> days.
+    /// </summary>
+    static std::vector<double> fixed(int days)
+    {
+        std::vector<double> pmf(days + 1, 0.0);
+        pmf[days] = 1.0;
+        return pmf;
+    }
+
+    /// <summary>
+    /// Dwell-time distribution of <c>min</c> days plus a geometric number of days (as in <c>Pathogen</c>).
+    /// </summary>
+    /// <param name="min">minimum number of days</param>
+    /// <param name="mean">average number of days</param>
+    static std::vector<double> geometric(int min, double mean)
+    {
+        auto p = 1.0 / (mean - min + 1);
+        std::vector<double> pmf(min, 0.0);
+        for (double q = p, mass = 0; mass < 1 - 1e-9 && pmf.size() < 4096; q *= 1 - p) {
+            pmf.push_back(q);
+            mass += q;
+        }
+        return pmf;
+    }
+
+    /// <summary>
+    /// Build the dense lookup tables consumed by <c>ModelMap</c>.
+    /// </summary>
+    void compile()
+    {
+        if (susceptible < 0 || entry < 0) throw std::logic_error("CompartmentModel: infection not set");
+        auto n = states.size();
+        thresholds.assign(n, {});
+        targets.assign(n, {});
+        dwellTable.assign(n, {});
+        exposure.assign(n, 0);
+        absorbing.assign(n, 0);
+        for (size_t s = 0; s < n; ++s) {
+            auto& st = states[s];
+            absorbing[s] = st.dwell.empty() || st.branches.empty();
+            auto& th = thresholds[s];
+            auto& tg = targets[s];
+            th.fill(UINT32_MAX);
+            tg.fill(static_cast<uint8_t>(s));
+            double total = 0;
+            for (auto& b : st.branches) total += b.second;
+            double cumulative = 0;
+            for (size_t b = 0; b < st.branches.size(); ++b) {
+                tg[b] = static_cast<uint8_t>(st.branches[b].first);
+                cumulative += st.branches[b].second / total;
+                // Branch b is taken when the word exceeds b thresholds; unused
+                // thresholds stay at UINT32_MAX, which no word exceeds.
+                auto w = word(cumulative);
+                if (b + 1 < st.branches.size()) th[b] = w ? w - 1 : 0;
+            }
+            double sum = 0;
+            for (auto m : st.dwell) sum += m;
+            for (int q = 0; q < dwell_resolution; ++q) {
+                auto u = (q + 0.5) / dwell_resolution * sum;
+                size_t d = 0;
+                for (double c = 0; d < st.dwell.size(); ++d) {
+                    c += st.dwell[d];
+                    if (c >= u) break;
+                }
+                dwellTable[s][q] = static_cast<uint16_t>(std::max<size_t>(1, std::min<size_t>(d, UINT16_MAX)));
+            }
+        }
+        compiled = true;
+        beginDay(0);
+    }
+
+    /// <summary>SEIRD model equivalent to a <c>Pathogen</c>, including its forcing.</summary>
+    /// <param name="p">the pathogen whose parameters to use</param>
+    static CompartmentModel seird(Pathogen const& p)
+    {
+        CompartmentModel m(p.baseTransmissionProbability(), p.meanContacts());
+        auto S = m.addState("susceptible");
+        auto E = m.addState("exposed", 0.0f, geometric(p.minIncubation(), p.meanIncubation()));
+        auto I = m.addState("infected", 1.0f, geometric(p.minInfection(), p.meanInfection()));
+        auto R = m.addState("recovered");
+        auto D = m.addState("deceased");
+        m.setInfection(S, E);
+        m.addTransition(E, I, 1.0);
+        m.addTransition(I, R, 1 - p.deathProbability());
+        m.addTransition(I, D, p.deathProbability());
+        m.catchForcing = p.getTransmissionForcing();
+        m.contactForcing = p.getContactForcing();
+        m.compile();
+        return m;
+    }
+
+    /// <summary>SEIRS model with waning immunity, based on a <c>Pathogen</c> and its forcing.</summary>
+    /// <param name="p">the pathogen whose parameters to use</param>
+    /// <param name="immunity">average number of days until a recovered host is susceptible again</param>
+    static CompartmentModel seirs(Pathogen const& p, double immunity)
+    {
+        CompartmentModel m(p.baseTransmissionProbability(), p.meanContacts());
+        auto S = m.addState("susceptible");
+        auto E = m.addState("exposed", 0.0f, geometric(p.minIncubation(), p.meanIncubation()));
+        auto I = m.addState("infected", 1.0f, geometric(p.minInfection(), p.meanInfection()));
+        auto R = m.addState("recovered", 0.0f, geometric(1, immunity));
+        auto D = m.addState("deceased");
+        m.setInfection(S, E);
+        m.addTransition(E, I, 1.0);
+        m.addTransition(I, R, 1 - p.deathProbability());
+        m.addTransition(I, D, p.deathProbability());
+        m.addTransition(R, S, 1.0);
+        m.catchForcing = p.getTransmissionForcing();
+        m.contactForcing = p.getContactForcing();
+        m.compile();
+        return m;
+    }
+
+    /// <summary>Number of states in the model.</summary>
+    int stateCount() const { return static_cast<int>(states.size()); }
+
+    /// <summary>Label of a state.</summary>
+    std::string const& stateName(int s) const { return states[s].name; }
+
+    /// <summary>Index of the susceptible state.</summary>
+    int susceptibleState() const { return susceptible; }
+
+    /// <summary>Index of the state entered upon infection.</summary>
+    int entryState() const { return entry; }
+
+    /// <summary>Average number of contacts per day.</summary>
+    double meanContacts() const { return kT; }
+
+    /// <summary>Multiplier on the number of contacts for the day set by <c>beginDay</c>.</summary>
+    double contactScale() const { return contactFactor; }
+
+    /// <summary>Whether <c>compile()</c> has been called since the last change.</summary>
+    bool isCompiled() const { return compiled; }
+
+    /// <summary>Whether hosts stay in a state indefinitely (until infected, if susceptible).</summary>
+    bool isAbsorbing(int s) const { return absorbing[s] != 0; }
+
+    /// <summary>Whether hosts in a state make infectious contacts.</summary>
+    bool isInfectious(int s) const { return states[s].infectiousness > 0; }
+
+    /// <summary>
+    /// 32-bit threshold below which a uniform random word means a contact transmits on the current day.
+    /// </summary>
+    uint32_t exposureThreshold(int s) const { return exposure[s]; }
+
+    /// <summary>
+    /// State entered when the dwell time in state <c>s</c> runs out.
+    /// </summary>
+    /// <param name="s">the current state</param>
+    /// <param name="r">a uniform random 32-bit word</param>
+    int nextState(int s, uint32_t r) const
+    {
+        auto& th = thresholds[s];
+        int b = 0;
+        for (int k = 0; k + 1 < max_branches; ++k) b += r > th[k];
+        return targets[s][b];
+    }
+
+    /// <summary>
+    /// Number of days to spend in state <c>s</c>.
+    /// </summary>
+    /// <param name="s">the state being entered</param>
+    /// <param name="r">a uniform random byte</param>
+    uint16_t dwellTime(int s, uint8_t r) const { return dwellTable[s][r]; }
+
+private:
+    struct State
+    {
+        std::string name;
+        float infectiousness;
+        std::vector<double> dwell;
+        std::vector<std::pair<int, double>> branches;
+    };
+
+    static uint32_t word(double p)
+    {
+        return p >= 1.0 ? UINT32_MAX : static_cast<uint32_t>(p * 4294967296.0);
+    }
+
+    double pE;
+    double kT;
+    double contactFactor = 1.0;
+    Forcing catchForcing;
+    Forcing contactForcing;
+    int susceptible = -1;
+    int entry = -1;
+    bool compiled = false;
+    std::vector<State> states;
+    std::vector<std::array<uint32_t, max_branches>> thresholds;
+    std::vector<std::array<uint8_t, max_branches>> targets;
+    std::vector<std::array<uint16_t, dwell_resolution>> dwellTable;
+    std::vector<uint32_t> exposure;
+    std::vector<uint8_t> absorbing;
+};
+
+/// <summary>
+/// Rectangular grid of hosts following a table-driven <c>CompartmentModel</c>.
+/// </summary>
+/// <remarks>
+/// Host state, days remaining and contact counts are stored in separate
+/// columns (5 Bytes per host). As in <c>HostMap</c>, only hosts in
+/// non-absorbing states are visited each day: the transition kernel first
+/// decrements every active timer in a tight loop, then resolves the expired
+/// ones through the model's lookup tables.
+/// </remarks>
+class ModelMap
+{
+public:
+    /// <summary>
+    /// Initialize this map with the specified dimensions and model.
+    /// </summary>
+    /// <param name="model">a compartment model (compiled if necessary)</param>
+    /// <param name="r">number of rows in the grid</param>
+    /// <param name="c">number of columns in the grid</param>
+    ModelMap(CompartmentModel const& model, int r = 100, int c = 100)
+        : model(model), rows(r), cols(c), state(static_cast<size_t>(r) * c),
+        timer(state.size()), contacts(state.size()), gen(std::random_device()())
+    {
+        if (!this->model.isCompiled()) this->model.compile();
+        reset();
+    }
+
+    /// <summary>Width of the the map.</summary>
+    size_t col_count() const { return cols; }
+
+    /// <summary>Height of the the map.</summary>
+    size_t row_count() const { return rows; }
+
+    /// <summary>Number of days simulated since the last reset.</summary>
+    unsigned getDay() const { return day; }
+
+    /// <summary>The model driving this map.</summary>
+    CompartmentModel const& getModel() const { return model; }
+
+    /// <summary>
+    /// Make every run reproducible by drawing from an engine seeded by a key at each reset.
+    /// </summary>
+    /// <param name="k">key identifying the replicate</param>
+    /// <remarks>Call before <c>reset</c>.</remarks>
+    void setRandomKey(uint64_t k)
+    {
+        key = k;
+        keyed = true;
+    }
+
+    /// <summary>Return to independent random draws.</summary>
+    void clearRandomKey() { keyed = false; }
+
+    /// <summary>Resets every host to the susceptible state.</summary>
+    void reset()
+    {
+        if (keyed) {
+            auto h = mixKey(key, 0);
+            std::seed_seq seq{ static_cast<uint32_t>(h), static_cast<uint32_t>(h >> 32) };
+            gen.seed(seq);
+        }
+        auto S = static_cast<uint8_t>(model.susceptibleState());
+        std::fill(state.begin(), state.end(), S);
+        std::fill(timer.begin(), timer.end(), 0);
+        for (auto& t : contacts) t = static_cast<uint16_t>(1 + samplePoisson(gen, model.meanContacts()));
+        counts.assign(model.stateCount(), 0);
+        counts[S] = static_cast<long long>(state.size());
+        active.clear();
+        day = 0;
+    }
+
+    /// <summary>
+    /// Plant the disease in a given number of individuals.
+    /// </summary>
+    /// <param name="count">number of infected individuals at the start of the simulation</param>
+    void seedDisease(int count)
+    {
+        std::uniform_int_distribution<size_t> d(0, state.size() - 1);
+        for (auto attempts = 100 * count; count > 0 && attempts > 0; --attempts) {
+            auto k = d(gen);
+            if (state[k] != model.susceptibleState()) continue;
+            infect(k);
+            active.push_back(static_cast<int>(k));
+            --count;
+        }
+    }
+
+    /// <summary>
+    /// Advance the simulation one time step (i.e., day).
+    /// </summary>
+    void computeNext()
+    {
+        model.beginDay(day);
+        exposed.clear();
+        for (auto k : active) {
+            if (model.isInfectious(state[k])) computeContacts(k);
+        }
+
+        // Vectorizable pass: count down every active timer.
+        auto n = active.size();
+        expired.resize(n);
+        for (size_t a = 0; a < n; ++a) {
+            auto k = active[a];
+            auto t = static_cast<uint16_t>(timer[k] - 1);
+            timer[k] = t;
+            expired[a] = t == 0;
+        }
+
+        next.clear();
+        for (size_t a = 0; a < n; ++a) {
+            auto k = active[a];
+            if (expired[a]) {
+                auto from = state[k];
+                auto to = model.nextState(from, static_cast<uint32_t>(gen()));
+                --counts[from];
+                ++counts[to];
+                state[k] = static_cast<uint8_t>(to);
+                if (model.isAbsorbing(to)) continue;
+                timer[k] = model.dwellTime(to, static_cast<uint8_t>(gen()));
+            }
+            next.push_back(k);
+        }
+        next.insert(next.end(), exposed.begin(), exposed.end());
+        active.swap(next);
+        ++day;
+    }
+
+    /// <summary>
+    /// Count the hosts in one state.
+    /// </summary>
+    /// <param name="s">index of a model state</param>
+    /// <returns>number of hosts currently in state <c>s</c></returns>
+    long long count(int s) const { return counts[s]; }
+
+    /// <summary>
+    /// Count the hosts in non-absorbing states (e.g., exposed, infected, waning).
+    /// </summary>
+    /// <returns>number of hosts visited by the daily step</returns>
+    long long countActive() const { return static_cast<long long>(active.size()); }
+
+    /// <summary>
+    /// State of a host.
+    /// </summary>
+    /// <param name="k">row-major index of the host</param>
+    int stateAt(size_t k) const { return state[k]; }
+
+    /// <summary>
+    /// Print the number of hosts in each state.
+    /// </summary>
+    void printSummary() const
+    {
+        for (int s = 0; s < model.stateCount(); ++s) {
+            std::cout << (s ? ", " : "") << counts[s] << ' ' << model.stateName(s);
+        }
+        std::cout << std::endl;
+    }
+
+private:
+    void infect(size_t k)
+    {
+        auto E = model.entryState();
+        --counts[state[k]];
+        ++counts[E];
+        state[k] = static_cast<uint8_t>(E);
+        timer[k] = model.dwellTime(E, static_cast<uint8_t>(gen()));
+    }
+
+    void computeContacts(int k)
+    {
+        auto i = k / cols, j = k % cols;
+        auto threshold = model.exposureThreshold(state[k]);
+        auto S = model.susceptibleState();
+        auto t = contacts[k] * model.contactScale();
+        auto r = static_cast<int>(std::lround((std::sqrt(t + 1) - 1) / 2));
+        for (auto hi = i - r; hi <= i + r; ++hi) {
+            auto ri = (hi < 0) ? (rows + hi) : (hi >= rows ? (hi - rows) : hi);
+            for (auto hj = j - r; hj <= j + r; ++hj) {
+                auto cj = (hj < 0) ? (cols + hj) : (hj >= cols ? (hj - cols) : hj);
+                auto x = static_cast<size_t>(ri) * cols + cj;
+                if (state[x] == S && static_cast<uint32_t>(gen()) < threshold) {
+                    infect(x);
+                    exposed.push_back(static_cast<int>(x));
+                }
+            }
+        }
+    }
+
+    CompartmentModel model;
+    int rows;
+    int cols;
+    std::vector<uint8_t> state;
+    std::vector<uint16_t> timer;
+    std::vector<uint16_t> contacts;
+    std::vector<long long> counts;
+    std::vector<int> active;
+    std::vector<int> next;
+    std::vector<int> exposed;
+    std::vector<uint8_t> expired;
+    std::mt19937 gen;
+    unsigned day = 0;
+    bool keyed = false;
+    uint64_t key = 0;
+};
+
+#endif /*HPP_COMPARTMENTMODEL*/
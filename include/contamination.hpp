@@ -0,0 +1,161 @@
+#ifndef HPP_CONTAMINATION
+#define HPP_CONTAMINATION
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "counterrng.hpp"
+#include "hostmap.hpp"
+#include "parallel.hpp"
+
+/// <summary>
+/// Continuous environmental contamination field coupled to a <c>HostMap</c>.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Each day every infectious host sheds <c>shedding</c> units into its cell.
+/// The field then diffuses with a 5-point stencil on the torus and decays:
+/// <c>c' = (1 - decay) * (c + diffusion * (sum of 4 neighbors - 4c))</c>
+/// (stable for <c>diffusion</c> up to 0.25). A susceptible host in a cell
+/// with contamination <c>c</c> is infected with probability
+/// <c>1 - exp(-exposure * c)</c>, in addition to its close contacts.
+/// </para>
+/// <para>
+/// The stencil and the environmental exposure run in one fused pass over
+/// parallel row bands: each row is updated by a branch-free loop that
+/// compilers vectorize, and then its hosts are checked for exposure while the
+/// row is still in cache. Rows whose neighborhood holds no contamination
+/// above <c>floor</c> are skipped entirely. Each row draws from its own
+/// stream, seeded by <c>HostMap::layerSeed</c>, so the field is reproducible
+/// in paired mode and does not depend on the number of threads. The hosts
+/// found exposed are infected after the pass, and the map then advances in
+/// its own step; the field is not fused into <c>HostMap::computeNext</c>.
+/// </para>
+/// </remarks>
+class ContaminationField
+{
+public:
+    /// <summary>Contamination below this level is treated as none.</summary>
+    static constexpr float floor = 1e-6f;
+
+    /// <summary>
+    /// Initialize an uncontaminated field aligned with a map.
+    /// </summary>
+    /// <param name="map">the host map this field is coupled to</param>
+    /// <param name="shedding">units shed into its cell by each infectious host per day</param>
+    /// <param name="decay">fraction of contamination lost per day</param>
+    /// <param name="diffusion">fraction exchanged with each of the four neighbors per day</param>
+    /// <param name="exposure">infection hazard per unit of contamination per day</param>
+    ContaminationField(HostMap const& map, float shedding = 1.0f, float decay = 0.2f,
+        float diffusion = 0.1f, float exposure = 0.01f)
+        : rows(static_cast<int>(map.row_count())), cols(static_cast<int>(map.col_count())),
+        shedding(shedding), decay(decay), diffusion(std::min(diffusion, 0.25f)), exposure(exposure),
+        field(static_cast<size_t>(rows) * cols, 0.0f), next(field.size(), 0.0f),
+        dirty(rows, 0), nextDirty(rows, 0), infected(workerCount())
+    {}
+
+    /// <summary>Removes all contamination.</summary>
+    void reset()
+    {
+        std::fill(field.begin(), field.end(), 0.0f);
+        std::fill(dirty.begin(), dirty.end(), 0);
+    }
+
+    /// <summary>
+    /// Contamination level of a cell.
+    /// </summary>
+    /// <param name="k">row-major index of a cell</param>
+    float at(size_t k) const { return field[k]; }
+
+    /// <summary>
+    /// Shed, diffuse, decay and expose for one day, then advance the map one day.
+    /// </summary>
+    /// <param name="map">the host map this field is coupled to</param>
+    void advance(HostMap& map)
+    {
+        for (auto const* list : { &map.spreadingHosts(), &map.isolatedHosts() }) {
+            for (auto k : *list) {
+                field[k] += shedding;
+                dirty[k / cols] = 1;
+            }
+        }
+
+        auto keep = 1.0f - decay;
+        auto D = diffusion;
+        auto hazard = exposure;
+        auto seed = map.layerSeed(layerTag);
+        auto& disease = map.getDisease();
+        parallelFor(0, rows, [&](size_t lo, size_t hi, unsigned w) {
+            std::uniform_real_distribution<float> u(0.0f, 1.0f);
+            auto& found = infected[w];
+            found.clear();
+            for (auto i = static_cast<int>(lo); i < static_cast<int>(hi); ++i) {
+                auto up = (i == 0 ? rows : i) - 1, down = (i + 1 == rows ? 0 : i + 1);
+                if (!dirty[up] && !dirty[i] && !dirty[down]) {
+                    if (nextDirty[i]) {
+                        std::fill(next.begin() + static_cast<size_t>(i) * cols,
+                            next.begin() + static_cast<size_t>(i + 1) * cols, 0.0f);
+                        nextDirty[i] = 0;
+                    }
+                    continue;
+                }
+                auto c = &field[static_cast<size_t>(i) * cols];
+                auto n = &field[static_cast<size_t>(up) * cols];
+                auto s = &field[static_cast<size_t>(down) * cols];
+                auto out = &next[static_cast<size_t>(i) * cols];
+
+                // 5-point stencil; the interior loop is vectorized.
+                out[0] = keep * (c[0] + D * (n[0] + s[0] + c[cols - 1] + c[1 % cols] - 4 * c[0]));
+                for (int j = 1; j < cols - 1; ++j) {
+                    out[j] = keep * (c[j] + D * (n[j] + s[j] + c[j - 1] + c[j + 1] - 4 * c[j]));
+                }
+                if (cols > 1) {
+                    auto j = cols - 1;
+                    out[j] = keep * (c[j] + D * (n[j] + s[j] + c[j - 1] + c[0] - 4 * c[j]));
+                }
+
+                // Environmental exposure of this row's hosts, while it is in cache.
+                CounterEngine gen(mixKey(seed, i));
+                float peak = 0.0f;
+                auto& row = map[i];
+                for (int j = 0; j < cols; ++j) {
+                    peak = std::max(peak, out[j]);
+                    if (c[j] > floor && disease.isSusceptible(row[j])
+                        && u(gen) < -std::expm1(-hazard * c[j])) {
+                        found.push_back(i * cols + j);
+                    }
+                }
+                nextDirty[i] = peak > floor;
+                if (!nextDirty[i]) std::fill(out, out + cols, 0.0f);
+            }
+        }, static_cast<unsigned>(infected.size()));
+
+        field.swap(next);
+        dirty.swap(nextDirty);
+
+        for (auto& found : infected) {
+            for (auto k : found) map.infectHost(k);
+        }
+        map.computeNext();
+    }
+
+private:
+    static constexpr uint64_t layerTag = 0x636f6e74;      // "cont"
+
+    int rows;
+    int cols;
+    float shedding;
+    float decay;
+    float diffusion;
+    float exposure;
+    std::vector<float> field;
+    std::vector<float> next;
+    // A row whose flag is clear holds only zeros in the corresponding buffer.
+    std::vector<uint8_t> dirty;
+    std::vector<uint8_t> nextDirty;
+    std::vector<std::vector<int>> infected;
+};
+
+#endif /*HPP_CONTAMINATION*/
@@ -0,0 +1,69 @@
+#ifndef HPP_COUNTERRNG
+#define HPP_COUNTERRNG
+
+#include <cstdint>
+#include <limits>
+
+/// <summary>
+/// Mix two 64-bit words into one well-distributed key.
+/// </summary>
+/// <param name="a">first word (e.g., a base key)</param>
+/// <param name="b">second word (e.g., a replicate or host index)</param>
+/// <returns>a hash of the pair</returns>
+/// <remarks>
+/// Uses the SplitMix64 finalizer, so nearby inputs give unrelated keys.
+/// </remarks>
+inline uint64_t mixKey(uint64_t a, uint64_t b)
+{
+    auto z = a + 0x9e3779b97f4a7c15ull * (b + 1);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/// <summary>
+/// Counter-based random number engine: the n-th output of a stream is a hash of (key, n).
+/// </summary>
+/// <remarks>
+/// <para>
+/// A stream is cheap to create, and any number of independent streams can be
+/// addressed directly by key (e.g., one per host and purpose), so two runs
+/// that use the same keys draw the same numbers for the same decisions no
+/// matter in what order, or on which thread, the decisions are made.
+/// </para>
+/// <para>
+/// Satisfies the standard <c>UniformRandomBitGenerator</c> requirements, so it
+/// works with the <c>std</c> distributions and the samplers in <c>sampling.hpp</c>.
+/// </para>
+/// </remarks>
+class CounterEngine
+{
+public:
+    using result_type = uint64_t;
+
+    /// <summary>
+    /// Initialize the stream with a given key.
+    /// </summary>
+    /// <param name="key">identifies the stream</param>
+    /// <param name="counter">position in the stream</param>
+    explicit CounterEngine(uint64_t key = 0, uint64_t counter = 0) : key(key), counter(counter) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    /// <summary>Next value of the stream.</summary>
+    result_type operator()() { return mixKey(key, counter++); }
+
+    /// <summary>Restart at the beginning of another stream.</summary>
+    void seek(uint64_t k, uint64_t n = 0)
+    {
+        key = k;
+        counter = n;
+    }
+
+private:
+    uint64_t key;
+    uint64_t counter;
+};
+
+#endif /*HPP_COUNTERRNG*/
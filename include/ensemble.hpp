@@ -0,0 +1,301 @@
+#ifndef HPP_ENSEMBLE
+#define HPP_ENSEMBLE
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "hostmap.hpp"
+#include "parallel.hpp"
+#include "raster.hpp"
+
+/// <summary>
+/// Gathers results from the replicates of an <c>Ensemble</c>.
+/// </summary>
+/// <remarks>
+/// Each ensemble worker owns a map and runs whole replicates on it, so a
+/// collector keeps per-worker state (indexed by <c>worker</c>) that needs
+/// no locking, and combines it in <c>finish</c>.
+/// </remarks>
+class EnsembleCollector
+{
+public:
+    virtual ~EnsembleCollector() = default;
+
+    /// <summary>
+    /// Called once before any replicate runs.
+    /// </summary>
+    /// <param name="workers">number of workers; worker indices are below this</param>
+    /// <param name="rows">number of rows in each map</param>
+    /// <param name="cols">number of columns in each map</param>
+    virtual void prepare(unsigned workers, size_t rows, size_t cols) { (void)workers; (void)rows; (void)cols; }
+
+    /// <summary>
+    /// Observer to attach to the map of a worker, if any.
+    /// </summary>
+    /// <param name="worker">index of the worker</param>
+    virtual InfectionObserver* observer(unsigned worker) { (void)worker; return nullptr; }
+
+    /// <summary>
+    /// Called by a worker when one of its replicates has finished.
+    /// </summary>
+    /// <param name="map">the worker's map at the end of the replicate</param>
+    /// <param name="replicate">index of the replicate</param>
+    /// <param name="worker">index of the worker</param>
+    virtual void replicateDone(HostMap const& map, unsigned replicate, unsigned worker) = 0;
+
+    /// <summary>
+    /// Called once after every replicate has finished, to combine per-worker results.
+    /// </summary>
+    virtual void finish() {}
+
+    /// <summary>
+    /// Indicates that this collector has seen enough replicates.
+    /// </summary>
+    /// <remarks>
+    /// Checked by the workers after each replicate, so it must be safe to call
+    /// concurrently with <c>replicateDone</c>. Once any collector reports
+    /// enough, the ensemble hands out no further replicates but finishes
+    /// those already started (see <c>Ensemble</c>).
+    /// </remarks>
+    virtual bool enough() const { return false; }
+};
+
+/// <summary>
+/// Runs many independent replicates of a scenario in parallel.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Every worker thread owns one map, which is reset before each replicate
+/// and prepared by the setup function (seeding, interventions, ...).
+/// Replicates are handed out one at a time, so workers stay busy even when
+/// some replicates die out early. A replicate runs until the horizon or
+/// until no infections remain.
+/// </para>
+/// <para>
+/// A run can stop before the requested number of replicates when a
+/// collector reports <c>enough</c>. Replicates still in progress at that
+/// point are finished and reported, so the collectors always see the
+/// contiguous replicates <c>0..n-1</c>; abandoning them would drop the long
+/// (large-outbreak) replicates and bias the results toward small ones.
+/// <c>cancel</c>, which may be called from any thread, stops at once instead:
+/// replicates in progress are abandoned and never reported.
+/// </para>
+/// </remarks>
+class Ensemble
+{
+public:
+    /// <summary>
+    /// Initialize an ensemble for a scenario.
+    /// </summary>
+    /// <param name="disease">representation of a communicable disease</param>
+    /// <param name="r">number of rows in each map</param>
+    /// <param name="c">number of columns in each map</param>
+    /// <param name="horizon">maximum number of days simulated per replicate</param>
+    /// <param name="setup">prepares a freshly reset map for a given replicate</param>
+    Ensemble(Pathogen const& disease, int r, int c, unsigned horizon,
+        std::function<void(HostMap&, unsigned)> setup)
+        : disease(disease), rows(r), cols(c), horizon(horizon), setup(std::move(setup))
+    {}
+
+    /// <summary>Maximum number of days simulated per replicate.</summary>
+    unsigned days() const { return horizon; }
+
+    /// <summary>
+    /// Register a collector of results.
+    /// </summary>
+    /// <param name="c">a collector, which must outlive the call to <c>run</c></param>
+    void addCollector(EnsembleCollector* c) { collectors.push_back(c); }
+
+    /// <summary>
+    /// Run replicates in paired (common random numbers) mode.
+    /// </summary>
+    /// <param name="base">key shared by ensembles that are to be compared</param>
+    /// <remarks>
+    /// Replicate <c>r</c> runs with key <c>mixKey(base, r)</c> (see
+    /// <c>HostMap::setRandomKey</c>), so replicate <c>r</c> of a baseline and of
+    /// an intervention ensemble with the same base form a matched pair.
+    /// </remarks>
+    void setPairedKey(uint64_t base)
+    {
+        pairedKey = base;
+        paired = true;
+    }
+
+    /// <summary>
+    /// Stop the current run as soon as possible, abandoning replicates in progress; safe to call from any thread.
+    /// </summary>
+    void cancel() { cancelled = true; }
+
+    /// <summary>
+    /// Run replicates.
+    /// </summary>
+    /// <param name="replicates">maximum number of replicates</param>
+    /// <param name="workers">number of threads (0 for <c>workerCount()</c>)</param>
+    /// <returns>the number of replicates completed</returns>
+    unsigned run(unsigned replicates, unsigned workers = 0)
+    {
+        workers = std::min(workers ? workers : workerCount(), std::max(replicates, 1u));
+        for (auto c : collectors) c->prepare(workers, rows, cols);
+        cancelled = false;
+        std::atomic<unsigned> next(0), done(0), limit(replicates);
+        parallelFor(0, workers, [&](size_t, size_t, unsigned w) {
+            HostMap map(disease, rows, cols);
+            for (auto c : collectors) {
+                if (auto o = c->observer(w)) map.addObserver(o);
+            }
+            for (auto rep = next++; rep < limit && !cancelled; rep = next++) {
+                if (paired) map.setRandomKey(mixKey(pairedKey, rep));
+                map.reset();
+                if (setup) setup(map, rep);
+                for (unsigned t = 0; t < horizon && map.countInfected() > 0 && !cancelled; ++t) {
+                    map.computeNext();
+                }
+                if (cancelled) break;
+                for (auto c : collectors) c->replicateDone(map, rep, w);
+                ++done;
+                for (auto c : collectors) {
+                    if (!c->enough()) continue;
+                    // Every replicate handed out so far still completes.
+                    auto handed = next.load(), current = limit.load();
+                    while (handed < current && !limit.compare_exchange_weak(current, handed)) {}
+                }
+            }
+        }, workers);
+        for (auto c : collectors) c->finish();
+        return done;
+    }
+
+private:
+    Pathogen disease;
+    int rows;
+    int cols;
+    unsigned horizon;
+    std::function<void(HostMap&, unsigned)> setup;
+    std::vector<EnsembleCollector*> collectors;
+    std::atomic<bool> cancelled{ false };
+    bool paired = false;
+    uint64_t pairedKey = 0;
+};
+
+/// <summary>
+/// Per-cell infection risk across an ensemble.
+/// </summary>
+/// <remarks>
+/// For every cell this counts the replicates in which its host was infected
+/// within the horizon, and sums the day of infection, so the memory is
+/// independent of the number of replicates. Each worker adds into its own
+/// shard of 32-bit accumulators, touching only the hosts infected in that
+/// replicate; the shards are summed once at the end.
+/// </remarks>
+class RiskMap : public EnsembleCollector
+{
+public:
+    void prepare(unsigned workers, size_t r, size_t c) override
+    {
+        rows = r;
+        cols = c;
+        total = 0;
+        shards.clear();
+        for (unsigned w = 0; w < workers; ++w) shards.emplace_back(new Shard(r * c));
+        hits.assign(r * c, 0);
+        daySum.assign(r * c, 0);
+    }
+
+    InfectionObserver* observer(unsigned worker) override { return shards[worker].get(); }
+
+    void replicateDone(HostMap const&, unsigned, unsigned worker) override
+    {
+        auto& s = *shards[worker];
+        for (auto const& e : s.infected) {
+            ++s.hits[e.first];
+            s.daySum[e.first] += e.second;
+        }
+        s.infected.clear();
+        ++s.replicates;
+    }
+
+    void finish() override
+    {
+        parallelFor(0, hits.size(), [&](size_t lo, size_t hi, unsigned) {
+            for (auto const& s : shards) {
+                for (auto k = lo; k < hi; ++k) {
+                    hits[k] += s->hits[k];
+                    daySum[k] += s->daySum[k];
+                }
+            }
+        });
+        for (auto const& s : shards) total += s->replicates;
+        shards.clear();
+    }
+
+    /// <summary>Number of replicates accumulated.</summary>
+    unsigned replicates() const { return total; }
+
+    /// <summary>
+    /// Fraction of replicates in which a host was infected.
+    /// </summary>
+    /// <param name="k">row-major index of a cell</param>
+    float probability(size_t k) const { return total ? static_cast<float>(hits[k]) / total : 0.0f; }
+
+    /// <summary>
+    /// Mean day of infection, among the replicates in which a host was infected.
+    /// </summary>
+    /// <param name="k">row-major index of a cell</param>
+    /// <returns>the mean day, or -1 if the host was never infected</returns>
+    float meanDay(size_t k) const { return hits[k] ? static_cast<float>(daySum[k]) / hits[k] : -1.0f; }
+
+    /// <summary>
+    /// Write the infection probability of every cell as a raster file.
+    /// </summary>
+    /// <param name="path">location of the raster file to create</param>
+    /// <param name="bits">bits per stored value (8 or 16)</param>
+    void writeProbability(std::string const& path, unsigned bits = 16) const
+    {
+        std::vector<float> v(hits.size());
+        for (size_t k = 0; k < v.size(); ++k) v[k] = probability(k);
+        QuantizedRaster::write(path, rows, cols, v.data(), bits);
+    }
+
+    /// <summary>
+    /// Write the mean infection day of every cell as a raster file (-1 where never infected).
+    /// </summary>
+    /// <param name="path">location of the raster file to create</param>
+    /// <param name="bits">bits per stored value (8 or 16)</param>
+    void writeMeanDay(std::string const& path, unsigned bits = 16) const
+    {
+        std::vector<float> v(hits.size());
+        for (size_t k = 0; k < v.size(); ++k) v[k] = meanDay(k);
+        QuantizedRaster::write(path, rows, cols, v.data(), bits);
+    }
+
+private:
+    /// <summary>
+    /// Accumulators of one worker, fed by the infections of its current replicate.
+    /// </summary>
+    struct Shard : InfectionObserver
+    {
+        explicit Shard(size_t n) : hits(n, 0), daySum(n, 0) {}
+
+        void onInfection(unsigned day, int, int infectee) override { infected.emplace_back(infectee, day); }
+        void onReset() override { infected.clear(); }
+
+        std::vector<uint32_t> hits;
+        std::vector<uint32_t> daySum;
+        std::vector<std::pair<int, unsigned>> infected;
+        unsigned replicates = 0;
+    };
+
+    size_t rows = 0;
+    size_t cols = 0;
+    unsigned total = 0;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<uint32_t> hits;
+    std::vector<uint32_t> daySum;
+};
+
+#endif /*HPP_ENSEMBLE*/
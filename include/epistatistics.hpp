@@ -0,0 +1,174 @@
+#ifndef HPP_EPISTATISTICS
+#define HPP_EPISTATISTICS
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+#include "hostmap.hpp"
+
+/// <summary>
+/// Running epidemic statistics, gathered as a <c>HostMap</c> advances.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Incidence is counted from the infections reported to the observer, and
+/// deaths and recoveries from the map's running totals, so no pass over the
+/// grid is needed. Each infection is also credited to its infector's
+/// infection-day cohort, which gives the case reproduction number
+/// <c>R(d)</c>: the mean number of secondary infections caused by hosts
+/// infected on day <c>d</c>. A cohort's value keeps growing until its hosts
+/// stop being infectious, so recent values are lower bounds.
+/// </para>
+/// <para>
+/// The doubling time compares the incidence of the last <c>window</c> days
+/// with that of the <c>window</c> days before; it is negative (a halving
+/// time) when incidence is falling.
+/// </para>
+/// </remarks>
+class EpiStatistics : public InfectionObserver
+{
+public:
+    /// <summary>
+    /// Totals for a single simulated day.
+    /// </summary>
+    struct Day
+    {
+        int incidence = 0;      ///< new infections
+        int deaths = 0;         ///< infections resolved by death
+        int recoveries = 0;     ///< infections resolved by recovery
+        int infectious = 0;     ///< infectious hosts at the end of the day
+        int secondary = 0;      ///< infections caused so far by hosts infected on this day
+    };
+
+    /// <summary>
+    /// Initialize empty statistics for a map.
+    /// </summary>
+    /// <param name="map">the map to be observed</param>
+    /// <param name="window">number of days compared by the doubling time</param>
+    EpiStatistics(HostMap const& map, unsigned window = 7)
+        : window(window), infectionDay(map.row_count() * map.col_count(), uint16_t(unknown))
+    {
+        days.emplace_back();
+    }
+
+    void onInfection(unsigned day, int infector, int infectee) override
+    {
+        grow(day);
+        ++days[day].incidence;
+        infectionDay[infectee] = static_cast<uint16_t>(day < unknown ? day : unknown - 1);
+        if (infector >= 0 && infectionDay[infector] != unknown) {
+            ++days[infectionDay[infector]].secondary;
+        }
+    }
+
+    void onDayEnd(HostMap const& map) override
+    {
+        auto day = map.getDay() - 1;
+        grow(day);
+        auto& d = days[day];
+        d.deaths = map.countDeceased() - deceased;
+        d.recoveries = map.countRecovered() - recovered;
+        d.infectious = map.countInfectious();
+        deceased = map.countDeceased();
+        recovered = map.countRecovered();
+        completed = map.getDay();
+    }
+
+    void onReset() override
+    {
+        days.assign(1, Day());
+        std::fill(infectionDay.begin(), infectionDay.end(), uint16_t(unknown));
+        deceased = recovered = 0;
+        completed = 0;
+    }
+
+    /// <summary>Number of days completed.</summary>
+    unsigned dayCount() const { return completed; }
+
+    /// <summary>
+    /// Totals for a given day.
+    /// </summary>
+    /// <param name="day">a completed day</param>
+    Day const& at(unsigned day) const { return days[day]; }
+
+    /// <summary>
+    /// Case reproduction number of hosts infected on a given day.
+    /// </summary>
+    /// <param name="day">an infection day</param>
+    /// <returns>mean secondary infections per host infected that day, or NaN if there were none</returns>
+    double reproductionNumber(unsigned day) const
+    {
+        if (day >= days.size() || days[day].incidence == 0) return std::numeric_limits<double>::quiet_NaN();
+        return static_cast<double>(days[day].secondary) / days[day].incidence;
+    }
+
+    /// <summary>
+    /// Effective reproduction number, from the most recent cohort old enough to have finished spreading.
+    /// </summary>
+    /// <param name="lag">days after infection by which a cohort is considered complete</param>
+    /// <returns>the pooled reproduction number of the <c>window</c> cohorts ending <c>lag</c> days ago</returns>
+    double effectiveR(unsigned lag) const
+    {
+        if (completed <= lag) return std::numeric_limits<double>::quiet_NaN();
+        auto end = completed - lag;
+        auto begin = end > window ? end - window : 0;
+        long cases = 0, secondary = 0;
+        for (auto d = begin; d < end; ++d) {
+            cases += days[d].incidence;
+            secondary += days[d].secondary;
+        }
+        return cases ? static_cast<double>(secondary) / cases : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    /// <summary>
+    /// Doubling time of incidence over the most recent days.
+    /// </summary>
+    /// <returns>days for incidence to double (negative: to halve), or NaN if undefined</returns>
+    double doublingTime() const
+    {
+        if (completed < 2 * window) return std::numeric_limits<double>::quiet_NaN();
+        long recent = 0, before = 0;
+        for (auto d = completed - window; d < completed; ++d) recent += days[d].incidence;
+        for (auto d = completed - 2 * window; d < completed - window; ++d) before += days[d].incidence;
+        if (recent == 0 || before == 0 || recent == before) return std::numeric_limits<double>::quiet_NaN();
+        return window * std::log(2.0) / std::log(static_cast<double>(recent) / before);
+    }
+
+    /// <summary>
+    /// Print one line of statistics for the most recent day.
+    /// </summary>
+    /// <param name="os">output stream</param>
+    /// <param name="lag">see <c>effectiveR</c></param>
+    void printDay(std::ostream& os, unsigned lag = 14) const
+    {
+        if (completed == 0) return;
+        auto const& d = days[completed - 1];
+        os << "day " << completed - 1
+            << ": " << d.incidence << " new, "
+            << d.deaths << " died, "
+            << d.recoveries << " recovered, "
+            << d.infectious << " infectious, R_t " << effectiveR(lag)
+            << ", doubling " << doublingTime() << " days"
+            << std::endl;
+    }
+
+private:
+    static constexpr uint16_t unknown = 0xffff;
+
+    void grow(unsigned day)
+    {
+        if (day >= days.size()) days.resize(day + 1);
+    }
+
+    unsigned window;
+    std::vector<Day> days;
+    std::vector<uint16_t> infectionDay;
+    int deceased = 0;
+    int recovered = 0;
+    unsigned completed = 0;
+};
+
+#endif /*HPP_EPISTATISTICS*/
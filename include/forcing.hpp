@@ -0,0 +1,77 @@
+#ifndef HPP_FORCING
+#define HPP_FORCING
+
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// Time-varying multiplier on a model parameter (e.g., seasonal transmission).
+/// </summary>
+/// <remarks>
+/// A forcing is evaluated once per simulated day, by the map that owns it,
+/// into the value the per-host kernels read; it is never evaluated per host.
+/// A default-constructed forcing is the constant 1 and costs nothing.
+/// </remarks>
+class Forcing
+{
+public:
+    /// <summary>Initialize the constant forcing 1.</summary>
+    Forcing() = default;
+
+    /// <summary>
+    /// Initialize a forcing from an arbitrary function of the day.
+    /// </summary>
+    /// <param name="f">multiplier as a function of the simulation day</param>
+    explicit Forcing(std::function<double(unsigned)> f) : f(std::move(f)) {}
+
+    /// <summary>
+    /// Sinusoidal seasonal forcing <c>1 + amplitude * cos(2 pi (day - peak) / period)</c>.
+    /// </summary>
+    /// <param name="amplitude">relative amplitude, in [0,1]</param>
+    /// <param name="period">length of a season cycle, in days</param>
+    /// <param name="peak">day on which the multiplier is largest</param>
+    static Forcing seasonal(double amplitude, double period = 365.0, double peak = 0.0)
+    {
+        auto w = 2 * 3.14159265358979323846 / period;
+        return Forcing([=](unsigned day) { return 1 + amplitude * std::cos(w * (day - peak)); });
+    }
+
+    /// <summary>
+    /// Forcing given by a daily time series, e.g., mobility or behavior data.
+    /// </summary>
+    /// <param name="values">multiplier for days 0, 1, 2, ...</param>
+    /// <param name="cycle">repeat the series when it runs out, rather than holding its last value</param>
+    static Forcing series(std::vector<double> values, bool cycle = false)
+    {
+        if (values.empty()) return Forcing();
+        auto v = std::make_shared<std::vector<double> const>(std::move(values));
+        return Forcing([=](unsigned day) {
+            auto n = v->size();
+            return (*v)[cycle ? day % n : (day < n ? day : n - 1)];
+        });
+    }
+
+    /// <summary>
+    /// Indicates that this forcing is the constant 1.
+    /// </summary>
+    bool isConstant() const { return !f; }
+
+    /// <summary>
+    /// Evaluate the multiplier for a given day.
+    /// </summary>
+    /// <param name="day">the simulation day</param>
+    /// <returns>a non-negative multiplier</returns>
+    double operator()(unsigned day) const
+    {
+        if (!f) return 1.0;
+        auto x = f(day);
+        return x > 0 ? x : 0.0;
+    }
+
+private:
+    std::function<double(unsigned)> f;
+};
+
+#endif /*HPP_FORCING*/
@@ -0,0 +1,168 @@
+#ifndef HPP_HOSTATTRIBUTES
+#define HPP_HOSTATTRIBUTES
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "counterrng.hpp"
+
+/// <summary>
+/// Heterogeneous per-host attributes stored as compact columns (structure of arrays).
+/// </summary>
+/// <remarks>
+/// <para>
+/// Each column is indexed by the row-major position of a host in the grid,
+/// i.e., <c>i * cols + j</c>. Keeping attributes in separate contiguous columns
+/// (rather than widening <c>Host</c>) lets the step kernels stream only the
+/// attributes they need; storage is 10 Bytes per host.
+/// </para>
+/// <para>
+/// The probability that an infectious host <c>a</c> infects a susceptible
+/// contact <c>b</c> is the pathogen's baseline <c>pE</c> multiplied by
+/// <c>mixing(age[a], age[b]) * susceptibility[b]</c>, further reduced by the
+/// vaccine efficacy when <c>vaccineEfficacyApplies[b]</c> is set. An infected
+/// host dies with probability <c>mortality[b]</c> instead of the pathogen's
+/// <c>pD</c>.
+/// </para>
+/// <para>
+/// This models a leaky vaccine: protected hosts stay susceptible, with a
+/// lower chance of infection. <c>HostMap::vaccinate</c> instead makes hosts
+/// fully immune (state 7), and such hosts are never exposed at all.
+/// </para>
+/// <para>
+/// The random assignments take a seed (e.g., from <c>Pathogen::seed</c>), so
+/// they are reproducible in paired mode.
+/// </para>
+/// </remarks>
+class HostAttributes
+{
+public:
+    /// <summary>Age group index of each host.</summary>
+    std::vector<uint8_t> ageGroup;
+
+    /// <summary>Multiplier on the transmission probability for each host.</summary>
+    std::vector<float> susceptibility;
+
+    /// <summary>Probability of death given infection for each host.</summary>
+    std::vector<float> mortality;
+
+    /// <summary>Nonzero for each host whose transmission probability is reduced by the vaccine efficacy.</summary>
+    std::vector<uint8_t> vaccineEfficacyApplies;
+
+    /// <summary>
+    /// Initialize homogeneous attributes for a population.
+    /// </summary>
+    /// <param name="count">number of hosts (rows * columns of the grid)</param>
+    /// <param name="pD">baseline probability of death given infection</param>
+    /// <param name="groups">number of age groups</param>
+    HostAttributes(size_t count, double pD, size_t groups = 1)
+        : ageGroup(count, 0), susceptibility(count, 1.0f),
+        mortality(count, static_cast<float>(pD)), vaccineEfficacyApplies(count, 0),
+        groups(groups), mixing(groups * groups, 1.0f)
+    {
+        if (groups == 0 || groups > 256) {
+            throw std::invalid_argument("HostAttributes: age group count must be in [1,256]");
+        }
+    }
+
+    /// <summary>Number of hosts described by these columns.</summary>
+    /// <returns>length of each attribute column</returns>
+    size_t size() const { return ageGroup.size(); }
+
+    /// <summary>Number of age groups.</summary>
+    /// <returns>dimension of the age-mixing matrix</returns>
+    size_t groupCount() const { return groups; }
+
+    /// <summary>
+    /// Set the relative contact intensity from one age group to another.
+    /// </summary>
+    /// <param name="from">age group of the infectious host</param>
+    /// <param name="to">age group of the susceptible contact</param>
+    /// <param name="w">multiplier applied to the transmission probability</param>
+    void setMixing(size_t from, size_t to, float w) { mixing[from * groups + to] = w; }
+
+    /// <summary>
+    /// Relative contact intensity from one age group to another.
+    /// </summary>
+    /// <param name="from">age group of the infectious host</param>
+    /// <param name="to">age group of the susceptible contact</param>
+    /// <returns>multiplier applied to the transmission probability</returns>
+    float getMixing(size_t from, size_t to) const { return mixing[from * groups + to]; }
+
+    /// <summary>
+    /// Row of the age-mixing matrix for infectious hosts of one age group.
+    /// </summary>
+    /// <param name="from">age group of the infectious host</param>
+    /// <returns>pointer to <c>groupCount()</c> contiguous weights</returns>
+    float const* mixingRow(size_t from) const { return mixing.data() + from * groups; }
+
+    /// <summary>Set the fraction of transmissions prevented by vaccination.</summary>
+    /// <param name="e">vaccine efficacy in [0,1]</param>
+    void setVaccineEfficacy(float e) { efficacy = e; }
+
+    /// <summary>Fraction of transmissions prevented by vaccination.</summary>
+    /// <returns>vaccine efficacy in [0,1]</returns>
+    float getVaccineEfficacy() const { return efficacy; }
+
+    /// <summary>
+    /// Multiplier on the transmission probability from one host to another.
+    /// </summary>
+    /// <param name="mix">mixing row of the infectious host (see <c>mixingRow</c>)</param>
+    /// <param name="b">index of the susceptible contact</param>
+    /// <returns>factor applied to the pathogen's baseline <c>pE</c></returns>
+    float transmissionScale(float const* mix, size_t b) const
+    {
+        return mix[ageGroup[b]] * susceptibility[b] * (vaccineEfficacyApplies[b] ? 1.0f - efficacy : 1.0f);
+    }
+
+    /// <summary>
+    /// Randomly assign age groups, susceptibility and mortality by group.
+    /// </summary>
+    /// <param name="weights">relative population size of each age group</param>
+    /// <param name="groupSusceptibility">susceptibility multiplier of each age group</param>
+    /// <param name="groupMortality">probability of death given infection for each age group</param>
+    /// <param name="seed">seed of the random assignment</param>
+    void assignAgeGroups(std::vector<double> const& weights,
+        std::vector<float> const& groupSusceptibility,
+        std::vector<float> const& groupMortality, uint64_t seed)
+    {
+        if (weights.size() != groups || groupSusceptibility.size() != groups
+            || groupMortality.size() != groups) {
+            throw std::invalid_argument("HostAttributes: expected one value per age group");
+        }
+        CounterEngine gen(seed);
+        std::discrete_distribution<int> d(weights.begin(), weights.end());
+        for (size_t k = 0; k < size(); ++k) {
+            auto g = d(gen);
+            ageGroup[k] = static_cast<uint8_t>(g);
+            susceptibility[k] = groupSusceptibility[g];
+            mortality[k] = groupMortality[g];
+        }
+    }
+
+    /// <summary>
+    /// Randomly give a fraction of the hosts in each age group the partial protection of the vaccine.
+    /// </summary>
+    /// <param name="coverage">fraction of each age group to vaccinate</param>
+    /// <param name="seed">seed of the random selection</param>
+    void vaccinate(std::vector<double> const& coverage, uint64_t seed)
+    {
+        if (coverage.size() != groups) {
+            throw std::invalid_argument("HostAttributes: expected one value per age group");
+        }
+        CounterEngine gen(seed);
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        for (size_t k = 0; k < size(); ++k) {
+            if (u(gen) < coverage[ageGroup[k]]) vaccineEfficacyApplies[k] = 1;
+        }
+    }
+
+private:
+    size_t groups;
+    std::vector<float> mixing;
+    float efficacy = 0.0f;
+};
+
+#endif /*HPP_HOSTATTRIBUTES*/
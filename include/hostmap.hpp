@@ -1,24 +1,127 @@
 #ifndef HPP_HOSTMAP
 #define HPP_HOSTMAP
 
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
 #include <cstdint>
 #include <functional>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
+#include "forcing.hpp"
+#include "hostattributes.hpp"
+#include "parallel.hpp"
 #include "pathogen.hpp"
+#include "raster.hpp"
+
+/// <summary>
+/// Rectangular block of cells in grid coordinates.
+/// </summary>
+struct Region
+{
+    int row = 0;    ///< first row of the block
+    int col = 0;    ///< first column of the block
+    int rows = 0;   ///< number of rows in the block
+    int cols = 0;   ///< number of columns in the block
+};
+
+class HostMap;
+
+/// <summary>
+/// Receives notifications from a <c>HostMap</c> as the simulation runs.
+/// </summary>
+/// <remarks>
+/// Observers are called from the thread advancing the map. An infection is
+/// reported as soon as it happens, so implementations should only append to
+/// a buffer or bump a counter, and leave any heavier work to <c>onDayEnd</c>.
+/// </remarks>
+class InfectionObserver
+{
+public:
+    virtual ~InfectionObserver() = default;
+
+    /// <summary>
+    /// A susceptible host has been infected.
+    /// </summary>
+    /// <param name="day">the day during which the infection took place</param>
+    /// <param name="infector">row-major index of the infecting host, or -1 if none (e.g., seeded or imported)</param>
+    /// <param name="infectee">row-major index of the newly exposed host</param>
+    virtual void onInfection(unsigned day, int infector, int infectee) = 0;
+
+    /// <summary>
+    /// The map has finished advancing a day.
+    /// </summary>
+    /// <param name="map">the map, whose <c>getDay()</c> is the number of days completed</param>
+    virtual void onDayEnd(HostMap const& map) { (void)map; }
+
+    /// <summary>
+    /// An infected host has changed state (e.g., become infectious, recovered or died).
+    /// </summary>
+    /// <param name="k">row-major index of the host</param>
+    /// <param name="from">state code before the change</param>
+    /// <param name="to">state code after the change</param>
+    virtual void onTransition(int k, int from, int to) { (void)k; (void)from; (void)to; }
+
+    /// <summary>
+    /// Hosts within a region may have changed state in bulk (e.g., vaccination or reset).
+    /// </summary>
+    /// <param name="map">the map, already in its new state</param>
+    /// <param name="region">block of cells that may have changed</param>
+    virtual void onRegionChanged(HostMap const& map, Region region) { (void)map; (void)region; }
+
+    /// <summary>
+    /// The map has been reset, discarding its history.
+    /// </summary>
+    /// <remarks>
+    /// Followed by <c>onRegionChanged</c> for the whole map once the new population is in place.
+    /// </remarks>
+    virtual void onReset() {}
+};
 
 /// <summary>
 /// Rectangular grid of host individuals along with a disease to model.
 /// </summary>
+/// <remarks>
+/// Besides the grid itself, the map keeps lists of the hosts with active
+/// infections (by row-major index <c>i * cols + j</c>) and running totals of
+/// resolved infections, so each day only touches infected hosts and their
+/// contacts. Hosts should therefore be infected through the map's own methods
+/// rather than by editing cells directly.
+/// </remarks>
 class HostMap : public std::vector<std::vector<Host>>
 {
     using super = std::vector<std::vector<Host>>;
     using row_type = std::vector<Host>;
 
     Pathogen disease;
+    HostAttributes const* attributes = nullptr;
+    SpatialParameters const* spatial = nullptr;
+
+    std::vector<int> incubating;    // exposed hosts
+    std::vector<int> spreading;     // infectious hosts that still make contacts
+    std::vector<int> isolated;      // infectious hosts in quarantine
+    std::vector<int> exposed;       // hosts exposed during the current day
+    std::vector<int> detected;      // hosts detected during the last day
+    std::vector<int> scratch[3];    // spare list buffers reused across days
+    int recovered = 0;
+    int deceased = 0;
+    int cumulative = 0;
+    int immunized = 0;
+    unsigned day = 0;
+
+    std::vector<InfectionObserver*> observers;
+    std::vector<float> tileContacts;    // contact multiplier per tile for the day (empty if uniform)
+    std::vector<float> tileScale;       // multipliers set by setContactScale (empty if uniform)
+    std::vector<std::pair<Region, Forcing>> tileForcing;    // regional forcing, in tile units
 
 public:
+    /// <summary>Side length, in cells, of the square tiles used for regional contact multipliers.</summary>
+    static constexpr int tile_size = 32;
+
     /// <summary>
     /// Initialize this map with the specified dimensions and disease
     /// </summary>
@@ -43,14 +146,105 @@ public:
     /// <returns>number of rows in the grid</returns>
     size_t row_count() const { return size(); }
 
+    /// <summary>Region covering the whole map.</summary>
+    /// <returns>a block spanning every row and column</returns>
+    Region bounds() const { return { 0, 0, static_cast<int>(row_count()), static_cast<int>(col_count()) }; }
+
+    /// <summary>Number of days simulated since the last reset.</summary>
+    /// <returns>the current simulation day</returns>
+    unsigned getDay() const { return day; }
+
+    /// <summary>The modeled disease.</summary>
+    /// <returns>the pathogen spreading on this map</returns>
+    Pathogen const& getDisease() const { return disease; }
+
+    /// <summary>
+    /// Draw every random decision from streams addressed by a key (common random numbers).
+    /// </summary>
+    /// <param name="key">key identifying the replicate</param>
+    /// <remarks>
+    /// Two maps reset with the same key start from the same population and,
+    /// for decisions about the same host, draw the same random numbers (see
+    /// <c>Pathogen::setKey</c>), so a scenario and its baseline can be
+    /// compared replicate by replicate. Call before <c>reset</c>.
+    /// </remarks>
+    void setRandomKey(uint64_t key) { disease.setKey(key); }
+
+    /// <summary>Return to independent random draws.</summary>
+    void clearRandomKey() { disease.clearKey(); }
+
+    /// <summary>
+    /// Seed for the random draws of a layer coupled to this map (e.g., contamination) on the current day.
+    /// </summary>
+    /// <param name="tag">distinguishes the layers, and the uses within a layer</param>
+    /// <returns>a seed derived from the key, the tag and the day in paired mode, or a fresh random seed otherwise</returns>
+    /// <remarks>
+    /// Layers split the seed per row with <c>mixKey</c>, as <c>vaccinate</c>
+    /// does, so their draws do not depend on the number of threads.
+    /// </remarks>
+    uint64_t layerSeed(uint64_t tag) const { return disease.seed(mixKey(mixKey(tag, day), ~0ull)); }
+
+    /// <summary>
+    /// Use heterogeneous per-host attributes in place of the pathogen's uniform parameters.
+    /// </summary>
+    /// <param name="attrs">attribute columns for every host, or <c>nullptr</c> for a homogeneous population</param>
+    /// <remarks>
+    /// The attributes are not copied and must outlive their use by this map.
+    /// </remarks>
+    void setAttributes(HostAttributes const* attrs)
+    {
+        if (attrs && attrs->size() != row_count() * col_count()) {
+            throw std::invalid_argument("HostMap: attribute columns do not match the grid size");
+        }
+        attributes = attrs;
+    }
+
+    /// <summary>
+    /// Vary transmission, contact intensity and population density across the map.
+    /// </summary>
+    /// <param name="params">raster layers aligned with the grid, or <c>nullptr</c> for a uniform map</param>
+    /// <remarks>
+    /// The parameters are not copied and must outlive their use by this map.
+    /// Setting them resets the map, since occupancy and contacts are drawn per cell.
+    /// </remarks>
+    void setSpatialParameters(SpatialParameters const* params)
+    {
+        if (params && !params->fits(row_count(), col_count())) {
+            throw std::invalid_argument("HostMap: raster layers do not match the grid size");
+        }
+        spatial = params;
+        reset();
+    }
+
     /// <summary>Resets the data for all hosts in the map.</summary>
     void reset()
     {
-        for (auto& row : *this) {
-            for (auto& cell : row) {
-                cell = std::make_tuple<short,short,short>(0, 0, disease.numNeighbors());
+        incubating.clear();
+        spreading.clear();
+        isolated.clear();
+        detected.clear();
+        recovered = deceased = cumulative = immunized = 0;
+        day = 0;
+        auxCalls.fill(0);
+        auxDay = 0;
+        for (auto o : observers) o->onReset();
+        tileScale.clear();
+        disease.beginDay(day);
+        updateContacts();
+        if (spatial) {
+            populate();
+        }
+        else {
+            auto M = col_count();
+            for (size_t i = 0; i < row_count(); ++i) {
+                auto& row = (*this)[i];
+                for (size_t j = 0; j < M; ++j) {
+                    disease.select(static_cast<int>(i * M + j));
+                    row[j] = std::make_tuple<short,short,short>(0, 0, disease.numNeighbors());
+                }
             }
         }
+        for (auto o : observers) o->onRegionChanged(*this, bounds());
     }
 
     /// <summary>
@@ -77,12 +271,28 @@ public:
     /// <param name="j">column position of a host in the grid</param>
     void computeContacts(int i, int j)
     {
-        auto t = std::get<2>((*this)[i][j]);
-        auto k = std::lround((std::sqrt(t + 1) - 1) / 2);
+        auto N = static_cast<int>(row_count());
+        auto M = static_cast<int>(col_count());
+        double t = std::get<2>((*this)[i][j]);
+        if (!tileContacts.empty()) t *= tileContacts[tileIndex(i, j)];
+        auto k = static_cast<int>(std::lround((std::sqrt(t + 1) - 1) / 2));
+        auto scaled = attributes || (spatial && spatial->hasTransmission());
         for (auto hi = i - k; hi <= i + k; ++hi) {
+            auto ri = (hi < 0) ? (N + hi) : (hi >= N ? (hi - N) : hi);
+            auto& row = (*this)[ri];
             for (auto hj = j - k; hj <= j + k; ++hj) {
-                auto& x = getNeighbor(hi, hj);
-                if (disease.isSusceptible(x)) disease.expose(x);
+                auto cj = (hj < 0) ? (M + hj) : (hj >= M ? (hj - M) : hj);
+                auto& x = row[cj];
+                if (!disease.isSusceptible(x)) continue;
+                disease.select(ri * M + cj, day, i * M + j);
+                if (scaled)
+                    disease.expose(x, transmissionScale(i * M + j, ri * M + cj));
+                else
+                    disease.expose(x);
+                if (disease.isExposed(x)) {
+                    exposed.push_back(ri * M + cj);
+                    for (auto o : observers) o->onInfection(day, i * M + j, ri * M + cj);
+                }
             }
         }
     }
@@ -90,28 +300,330 @@ public:
     /// <summary>
     /// Advance the simulation one time step (i.e., day).
     /// </summary>
+    /// <remarks>
+    /// Only infectious hosts outside quarantine are visited by the contact
+    /// pass; detected hosts move to the isolated list <c>timeQ</c> days after
+    /// detection and are never checked for contacts again.
+    /// </remarks>
     void computeNext()
     {
-        HostMap m_prev(*this);
-        auto N = row_count();
-        auto M = col_count();
-        for (auto i = 0; i < N; ++i) {
-            for (auto j = 0; j < M; ++j) {
-                auto& cell_prev = m_prev[i][j];
-                auto& cell = (*this)[i][j];
-                if (disease.isExposed(cell_prev))
-                    disease.worsen(cell);
-                else if (disease.isInfectious(cell_prev)) {
-                    disease.worsen(cell);
-                    // if (p.isDetected(cell_prev)) {
-                    //    std::get<2>(cell) = 0;
-                    //}
-                    computeContacts(i, j);
+        auto M = static_cast<int>(col_count());
+        if (!disease.isUnforced() || !tileForcing.empty()) {
+            disease.beginDay(day);
+            updateContacts();
+        }
+        for (auto k : spreading) {
+            computeContacts(k / M, k % M);
+        }
+
+        auto& nextIncubating = scratch[0];
+        auto& nextSpreading = scratch[1];
+        auto& nextIsolated = scratch[2];
+        nextIncubating.clear();
+        nextSpreading.clear();
+        nextIsolated.clear();
+        detected.clear();
+        for (auto const* list : { &incubating, &spreading, &isolated }) {
+            for (auto k : *list) {
+                auto& cell = (*this)[k / M][k % M];
+                auto wasDetected = disease.isDetected(cell);
+                auto was = std::get<0>(cell);
+                worsen(cell, k);
+                if (was != std::get<0>(cell)) {
+                    for (auto o : observers) o->onTransition(k, was, std::get<0>(cell));
+                }
+                if (!wasDetected && disease.isDetected(cell)) {
+                    detected.push_back(k);
+                }
+                if (disease.isExposed(cell)) {
+                    nextIncubating.push_back(k);
+                }
+                else if (disease.isInfectious(cell)) {
+                    if (list == &isolated || disease.isQuarantined(cell)) {
+                        std::get<2>(cell) = 0;
+                        nextIsolated.push_back(k);
+                    }
+                    else {
+                        nextSpreading.push_back(k);
+                    }
+                }
+                else if (disease.isDeceased(cell)) {
+                    ++deceased;
+                }
+                else {
+                    ++recovered;
+                }
+            }
+        }
+        nextIncubating.insert(nextIncubating.end(), exposed.begin(), exposed.end());
+        cumulative += static_cast<int>(exposed.size());
+        exposed.clear();
+        incubating.swap(nextIncubating);
+        spreading.swap(nextSpreading);
+        isolated.swap(nextIsolated);
+        ++day;
+        for (auto o : observers) o->onDayEnd(*this);
+    }
+
+    /// <summary>
+    /// Register an observer to be notified of infections and completed days.
+    /// </summary>
+    /// <param name="o">an observer, which must outlive its use by this map</param>
+    void addObserver(InfectionObserver* o) { observers.push_back(o); }
+
+    /// <summary>
+    /// Stop notifying an observer.
+    /// </summary>
+    /// <param name="o">a previously registered observer</param>
+    void removeObserver(InfectionObserver* o)
+    {
+        observers.erase(std::remove(observers.begin(), observers.end(), o), observers.end());
+    }
+
+    /// <summary>
+    /// Stop notifying every observer, e.g., on a copy of another map.
+    /// </summary>
+    void clearObservers() { observers.clear(); }
+
+    /// <summary>
+    /// Hosts that became detectable (symptomatic) during the most recent day.
+    /// </summary>
+    /// <returns>row-major indices of the newly detected cases</returns>
+    std::vector<int> const& newlyDetected() const { return detected; }
+
+    /// <summary>Hosts in the incubation stage.</summary>
+    /// <returns>row-major indices of the exposed hosts</returns>
+    std::vector<int> const& incubatingHosts() const { return incubating; }
+
+    /// <summary>Infectious hosts that make contacts (i.e., not in quarantine).</summary>
+    /// <returns>row-major indices of the spreading hosts</returns>
+    std::vector<int> const& spreadingHosts() const { return spreading; }
+
+    /// <summary>Infectious hosts in quarantine.</summary>
+    /// <returns>row-major indices of the isolated hosts</returns>
+    std::vector<int> const& isolatedHosts() const { return isolated; }
+
+    /// <summary>
+    /// Infect a single susceptible host, e.g., an imported case.
+    /// </summary>
+    /// <param name="k">row-major index of the host in the grid</param>
+    /// <returns><c>true</c> if the host was susceptible and is now exposed</returns>
+    bool infectHost(int k)
+    {
+        auto& cell = (*this)[k / col_count()][k % col_count()];
+        if (!disease.isSusceptible(cell)) return false;
+        disease.select(k, day);
+        disease.infect(cell);
+        incubating.push_back(k);
+        ++cumulative;
+        for (auto o : observers) o->onInfection(day, -1, k);
+        return true;
+    }
+
+    /// <summary>
+    /// Infect randomly chosen susceptible hosts within a region.
+    /// </summary>
+    /// <param name="region">block of cells receiving the cases</param>
+    /// <param name="count">number of cases to import</param>
+    /// <returns>the number of hosts actually infected</returns>
+    int importCases(Region region, int count)
+    {
+        region = clip(region);
+        if (region.rows <= 0 || region.cols <= 0) return 0;
+        std::default_random_engine gen(auxiliarySeed(auxImport));
+        std::uniform_int_distribution<> di(region.row, region.row + region.rows - 1);
+        std::uniform_int_distribution<> dj(region.col, region.col + region.cols - 1);
+        auto M = static_cast<int>(col_count());
+        int infected = 0;
+        for (auto attempts = 100 * count; infected < count && attempts > 0; --attempts) {
+            if (infectHost(di(gen) * M + dj(gen))) ++infected;
+        }
+        return infected;
+    }
+
+    /// <summary>
+    /// Immunize a random fraction of the susceptible hosts within a region.
+    /// </summary>
+    /// <param name="region">block of cells targeted by the campaign</param>
+    /// <param name="coverage">probability that each susceptible host is immunized</param>
+    /// <returns>the number of hosts immunized</returns>
+    /// <remarks>
+    /// Rows of the region are processed in parallel bands; each row draws
+    /// from its own stream, so the result does not depend on the thread count.
+    /// </remarks>
+    int vaccinate(Region region, double coverage)
+    {
+        region = clip(region);
+        if (region.rows <= 0 || region.cols <= 0) return 0;
+        std::vector<int> counts(workerCount(), 0);
+        auto seed = auxiliarySeed(auxVaccinate);
+        parallelFor(region.row, region.row + region.rows, [&](size_t lo, size_t hi, unsigned w) {
+            std::bernoulli_distribution d(coverage);
+            int n = 0;
+            for (auto i = lo; i < hi; ++i) {
+                CounterEngine gen(mixKey(seed, i));
+                auto& row = (*this)[i];
+                for (auto j = region.col; j < region.col + region.cols; ++j) {
+                    if (disease.isSusceptible(row[j]) && d(gen)) {
+                        disease.immunize(row[j]);
+                        ++n;
+                    }
                 }
             }
+            counts[w] = n;
+        }, static_cast<unsigned>(counts.size()));
+        int n = 0;
+        for (auto c : counts) n += c;
+        immunized += n;
+        if (n > 0) {
+            for (auto o : observers) o->onRegionChanged(*this, region);
         }
+        return n;
+    }
+
+    /// <summary>
+    /// Immunize a random fraction of the susceptible hosts within many small regions.
+    /// </summary>
+    /// <param name="regions">non-overlapping blocks of cells targeted by the campaign</param>
+    /// <param name="coverage">probability that each susceptible host is immunized</param>
+    /// <returns>the number of hosts immunized</returns>
+    /// <remarks>
+    /// Regions are distributed among threads, so they must not overlap.
+    /// </remarks>
+    int vaccinate(std::vector<Region> const& regions, double coverage)
+    {
+        std::vector<int> counts(workerCount(), 0);
+        auto seed = auxiliarySeed(auxVaccinate);
+        parallelFor(0, regions.size(), [&](size_t lo, size_t hi, unsigned w) {
+            std::bernoulli_distribution d(coverage);
+            int n = 0;
+            for (auto k = lo; k < hi; ++k) {
+                CounterEngine gen(mixKey(seed, k));
+                auto region = clip(regions[k]);
+                for (auto i = region.row; i < region.row + region.rows; ++i) {
+                    auto& row = (*this)[i];
+                    for (auto j = region.col; j < region.col + region.cols; ++j) {
+                        if (disease.isSusceptible(row[j]) && (coverage >= 1.0 || d(gen))) {
+                            disease.immunize(row[j]);
+                            ++n;
+                        }
+                    }
+                }
+            }
+            counts[w] = n;
+        }, static_cast<unsigned>(counts.size()));
+        int n = 0;
+        for (auto c : counts) n += c;
+        immunized += n;
+        if (n > 0) {
+            for (auto o : observers) {
+                for (auto const& r : regions) o->onRegionChanged(*this, clip(r));
+            }
+        }
+        return n;
+    }
+
+    /// <summary>
+    /// Set the contact multiplier of every tile that overlaps a region.
+    /// </summary>
+    /// <param name="region">block of cells (rounded out to whole tiles)</param>
+    /// <param name="scale">multiplier applied to the contacts of hosts in those tiles</param>
+    /// <remarks>
+    /// Multipliers replace rather than compound, so a closure of 0.5 is lifted
+    /// by setting 1 again. The cost is proportional to the number of tiles.
+    /// </remarks>
+    void setContactScale(Region region, float scale)
+    {
+        region = clip(region);
+        if (region.rows <= 0 || region.cols <= 0) return;
+        auto tr = tileRows(), tc = tileCols();
+        if (tileScale.empty()) tileScale.assign(tr * tc, 1.0f);
+        for (auto ti = region.row / tile_size; ti <= (region.row + region.rows - 1) / tile_size; ++ti) {
+            for (auto tj = region.col / tile_size; tj <= (region.col + region.cols - 1) / tile_size; ++tj) {
+                tileScale[ti * tc + tj] = scale;
+            }
+        }
+        updateContacts();
+    }
+
+    /// <summary>
+    /// Make the contacts of hosts in a region vary over time (e.g., regional seasonality).
+    /// </summary>
+    /// <param name="region">block of cells (rounded out to whole tiles)</param>
+    /// <param name="f">multiplier on contacts in those tiles as a function of the day</param>
+    /// <remarks>
+    /// Forcings compound with each other, with <c>setContactScale</c> and with
+    /// the pathogen's own contact forcing. They are evaluated once per day
+    /// per tile, so the cost is independent of the number of hosts. Like the
+    /// pathogen's forcing, and unlike <c>setContactScale</c>, they are part of
+    /// the scenario and persist across <c>reset</c>.
+    /// </remarks>
+    void setContactForcing(Region region, Forcing f)
+    {
+        region = clip(region);
+        if (region.rows <= 0 || region.cols <= 0) return;
+        Region tiles;
+        tiles.row = region.row / tile_size;
+        tiles.col = region.col / tile_size;
+        tiles.rows = (region.row + region.rows - 1) / tile_size - tiles.row + 1;
+        tiles.cols = (region.col + region.cols - 1) / tile_size - tiles.col + 1;
+        tileForcing.emplace_back(tiles, std::move(f));
+        updateContacts();
     }
 
+    /// <summary>
+    /// Remove every regional contact forcing.
+    /// </summary>
+    void clearContactForcing()
+    {
+        tileForcing.clear();
+        updateContacts();
+    }
+
+    /// <summary>
+    /// Advance the infection of a host by one day.
+    /// </summary>
+    /// <param name="cell">the host at row-major index <c>k</c></param>
+    /// <param name="k">row-major index of the host in the grid</param>
+    void worsen(Host& cell, int k)
+    {
+        disease.select(k, day);
+        if (attributes)
+            disease.worsen(cell, attributes->mortality[k]);
+        else
+            disease.worsen(cell);
+    }
+
+    /// <summary>
+    /// Count the number of infectious hosts currently in quarantine.
+    /// </summary>
+    /// <returns>total number of isolated hosts in the map</returns>
+    int countQuarantined() const { return static_cast<int>(isolated.size()); }
+
+    /// <summary>
+    /// Count the number of hosts in the incubation stage.
+    /// </summary>
+    /// <returns>total number of exposed hosts in the map</returns>
+    int countExposed() const { return static_cast<int>(incubating.size()); }
+
+    /// <summary>
+    /// Count the number of hosts able to spread the disease (including those in quarantine).
+    /// </summary>
+    /// <returns>total number of infectious hosts in the map</returns>
+    int countInfectious() const { return static_cast<int>(spreading.size() + isolated.size()); }
+
+    /// <summary>
+    /// Count the number of infections since the last reset.
+    /// </summary>
+    /// <returns>total number of hosts ever infected</returns>
+    int countCumulative() const { return cumulative; }
+
+    /// <summary>
+    /// Count the number of vaccinated individuals.
+    /// </summary>
+    /// <returns>total number of immunized hosts in the map</returns>
+    int countImmunized() const { return immunized; }
+
     /// <summary>
     /// Print a text representation of the map to standard output.
     /// </summary>
@@ -133,6 +645,12 @@ public:
                 else if (disease.isDeceased(cell)) {
                     std::cout << ' ';
                 }
+                else if (disease.isVacant(cell)) {
+                    std::cout << '~';
+                }
+                else if (disease.isImmune(cell)) {
+                    std::cout << 'v';
+                }
                 else if (disease.isRecovered(cell)) {
                     std::cout << 'R';
                 }
@@ -162,66 +680,143 @@ public:
     /// <returns>total number of infected hosts in the map</returns>
     int countInfected() const
     {
-        int count = 0;
-        for (auto& row : *this) {
-            for (auto& cell : row) {
-                if (disease.isExposed(cell) || disease.isInfectious(cell)) {
-                    ++count;
-                }
-            }
-        }
-        return count;
+        return static_cast<int>(incubating.size() + spreading.size() + isolated.size());
     }
 
     /// <summary>
     /// Count the number of recovered individuals.
     /// </summary>
     /// <returns>total number of recovered hosts in the map</returns>
-    int countRecovered() const
+    int countRecovered() const { return recovered; }
+
+    /// <summary>
+    /// Count the number of deceased individuals.
+    /// </summary>
+    /// <returns>total number of dead hosts in the map</returns>
+    int countDeceased() const { return deceased; }
+
+    /// <summary>
+    /// Plant the disease in a given number of individuals (i.e., "patient zero" candidates).
+    /// </summary>
+    /// <param name="count">number of infected individuals at the start of the simulation</param>
+    void seedDisease(int count)
     {
-        int count = 0;
-        for (auto& row : *this) {
-            for (auto& cell : row) {
-                if (disease.isRecovered(cell)) {
-                    ++count;
-                }
-            }
+        std::default_random_engine gen(auxiliarySeed(auxSeeding));
+        std::uniform_int_distribution<> d(0, static_cast<int>(row_count() * col_count()) - 1);
+        auto attempts = 100 * count;
+        while (count > 0 && attempts-- > 0) {
+            if (infectHost(d(gen))) --count;
         }
-        return count;
     }
 
+private:
+    enum { auxImport = 1, auxVaccinate, auxSeeding, auxPopulate, auxCount };
+
+    std::array<unsigned, auxCount> auxCalls{};  // auxiliary seeds drawn per purpose on auxDay
+    unsigned auxDay = 0;
+
     /// <summary>
-    /// Count the number of deceased individuals.
+    /// Seed for an auxiliary engine, reproducible when the disease is in paired mode.
     /// </summary>
-    /// <returns>total number of dead hosts in the map</returns>
-    int countDeceased() const
+    /// <remarks>
+    /// The seed depends on the purpose, the day and how many seeds of that
+    /// purpose were drawn earlier the same day, so repeated calls get distinct
+    /// streams while calls of other purposes (e.g., an extra vaccination in an
+    /// intervention run) do not shift them.
+    /// </remarks>
+    unsigned auxiliarySeed(unsigned tag)
     {
-        int count = 0;
-        for (auto& row : *this) {
-            for (auto& cell : row) {
-                if (disease.isDeceased(cell)) {
-                    ++count;
+        if (auxDay != day) {
+            auxCalls.fill(0);
+            auxDay = day;
+        }
+        return static_cast<unsigned>(disease.seed(mixKey(mixKey(tag, day), auxCalls[tag]++)));
+    }
+
+    size_t tileRows() const { return (row_count() + tile_size - 1) / tile_size; }
+    size_t tileCols() const { return (col_count() + tile_size - 1) / tile_size; }
+    size_t tileIndex(int i, int j) const { return (i / tile_size) * tileCols() + j / tile_size; }
+
+    /// <summary>
+    /// Combine the contact multipliers and forcings into the per-tile table for the current day.
+    /// </summary>
+    void updateContacts()
+    {
+        auto global = static_cast<float>(disease.contactScale());
+        if (tileScale.empty() && tileForcing.empty() && global == 1.0f) {
+            tileContacts.clear();
+            return;
+        }
+        auto tc = tileCols();
+        if (tileScale.empty())
+            tileContacts.assign(tileRows() * tc, global);
+        else {
+            tileContacts.resize(tileScale.size());
+            for (size_t t = 0; t < tileScale.size(); ++t) tileContacts[t] = tileScale[t] * global;
+        }
+        for (auto const& entry : tileForcing) {
+            auto f = static_cast<float>(entry.second(day));
+            auto const& r = entry.first;
+            for (auto ti = r.row; ti < r.row + r.rows; ++ti) {
+                for (auto tj = r.col; tj < r.col + r.cols; ++tj) {
+                    tileContacts[ti * tc + tj] *= f;
                 }
             }
         }
-        return count;
     }
 
     /// <summary>
-    /// Plant the disease in a given number of individuals (i.e., "patient zero" candidates).
+    /// Restrict a region to the cells of the grid.
     /// </summary>
-    /// <param name="count">number of infected individuals at the start of the simulation</param>
-    void seedDisease(int count)
+    Region clip(Region r) const
     {
-        std::random_device rd;
-        std::default_random_engine gen(rd());
-        std::uniform_int_distribution<> d(0, static_cast<int>(row_count() * col_count()) - 1);
-        while (count--) {
-            auto  k = d(gen);
-            auto  i = k / size();
-            auto  j = k % size();
-            auto& cell = (*this)[i][j];
-            disease.infect(cell);
+        auto r1 = std::min(r.row + r.rows, static_cast<int>(row_count()));
+        auto c1 = std::min(r.col + r.cols, static_cast<int>(col_count()));
+        r.row = std::max(r.row, 0);
+        r.col = std::max(r.col, 0);
+        r.rows = r1 - r.row;
+        r.cols = c1 - r.col;
+        return r;
+    }
+
+    /// <summary>
+    /// Multiplier on the transmission probability from one host to another.
+    /// </summary>
+    /// <param name="from">row-major index of the infectious host</param>
+    /// <param name="to">row-major index of the susceptible contact</param>
+    /// <returns>factor applied to the pathogen's baseline <c>pE</c></returns>
+    double transmissionScale(int from, int to) const
+    {
+        double scale = 1.0;
+        if (attributes)
+            scale *= attributes->transmissionScale(attributes->mixingRow(attributes->ageGroup[from]), to);
+        if (spatial)
+            scale *= spatial->transmissionScale(to);
+        return scale;
+    }
+
+    /// <summary>
+    /// Draw occupancy and contacts for every cell from the spatial parameters.
+    /// </summary>
+    void populate()
+    {
+        std::default_random_engine gen(auxiliarySeed(auxPopulate));
+        std::uniform_real_distribution<float> u(0.0f, 1.0f);
+        auto M = col_count();
+        for (size_t i = 0; i < row_count(); ++i) {
+            auto& row = (*this)[i];
+            for (size_t j = 0; j < M; ++j) {
+                auto k = i * M + j;
+                auto density = spatial->populationDensity(k);
+                if (density <= 0.0f || (density < 1.0f && u(gen) >= density)) {
+                    disease.vacate(row[j]);
+                    continue;
+                }
+                disease.select(static_cast<int>(k));
+                auto t = std::lround(disease.numNeighbors() * spatial->contactScale(k));
+                t = std::min(std::max(t, 0L), static_cast<long>(SHRT_MAX));
+                row[j] = std::make_tuple<short, short, short>(0, 0, static_cast<short>(t));
+            }
         }
     }
 };
@@ -0,0 +1,494 @@
+#ifndef HPP_HYBRIDMAP
+#define HPP_HYBRIDMAP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "pathogen.hpp"
+#include "sampling.hpp"
+
+/// <summary>
+/// Hybrid engine whose square tiles switch between individual hosts and compartment counts.
+/// </summary>
+/// <remarks>
+/// <para>
+/// A tile is individual-based (one <c>Host</c> record per cell) while it is
+/// within <c>frontDistance</c> tiles of the epidemic front, i.e., of a tile
+/// with active infections whose prevalence is below <c>saturation</c>.
+/// Every other tile (entirely susceptible and far ahead of the front, or
+/// saturated/burnt out behind it) is count-based: it stores only S/E/I/R/D
+/// totals and advances by a binomial chain as in <c>MetaMap</c>. Tiles are
+/// re-classified at the start of each day; counts are scattered at random
+/// over the cells when a tile becomes individual again.
+/// </para>
+/// <para>
+/// Coupling is symmetric. A contact from an individual host that lands in a
+/// count-based tile infects a random person there with probability
+/// <c>pE * S / N</c>. Each infectious person in a count-based tile directs a
+/// fraction <c>r / (2 * tile)</c> of its <c>kT</c> contacts across each edge
+/// (<c>r</c> being the mean contact radius); across an edge to another
+/// count-based tile these add to its force of infection, and across an edge
+/// to an individual tile they infect random hosts within <c>r</c> of that edge.
+/// Transmission and contact forcing of the pathogen apply in both
+/// representations.
+/// </para>
+/// </remarks>
+class HybridMap
+{
+    using Counts = std::array<uint32_t, 5>;   // S, E, I, R, D
+
+    struct Tile
+    {
+        int row0 = 0;
+        int col0 = 0;
+        int rows = 0;
+        int cols = 0;
+        bool individual = false;
+        Counts count{};
+        std::vector<Host> hosts;
+
+        uint32_t alive() const { return count[0] + count[1] + count[2] + count[3]; }
+        uint32_t active() const { return count[1] + count[2]; }
+    };
+
+public:
+    /// <summary>
+    /// Initialize this map with the specified dimensions and disease.
+    /// </summary>
+    /// <param name="disease">representation of a communicable disease</param>
+    /// <param name="r">number of rows in the grid</param>
+    /// <param name="c">number of columns in the grid</param>
+    /// <param name="tile">side length of the square tiles</param>
+    /// <param name="frontDistance">tiles within this (Chebyshev) distance of the front are individual-based</param>
+    /// <param name="saturation">prevalence above which a tile is no longer considered part of the front</param>
+    HybridMap(Pathogen const& disease, int r = 100, int c = 100, int tile = 32,
+        int frontDistance = 1, double saturation = 0.5)
+        : disease(disease), rows(r), cols(c), tile(tile),
+        tileRows((r + tile - 1) / tile), tileCols((c + tile - 1) / tile),
+        frontDistance(frontDistance), saturation(saturation)
+    {
+        tiles.resize(static_cast<size_t>(tileRows) * tileCols);
+        for (int ti = 0; ti < tileRows; ++ti) {
+            for (int tj = 0; tj < tileCols; ++tj) {
+                auto& t = tiles[ti * tileCols + tj];
+                t.row0 = ti * tile;
+                t.col0 = tj * tile;
+                t.rows = std::min(tile, r - t.row0);
+                t.cols = std::min(tile, c - t.col0);
+            }
+        }
+        reset();
+    }
+
+    /// <summary>Width of the the map.</summary>
+    /// <returns>number of columns in the grid</returns>
+    size_t col_count() const { return cols; }
+
+    /// <summary>Height of the the map.</summary>
+    /// <returns>number of rows in the grid</returns>
+    size_t row_count() const { return rows; }
+
+    /// <summary>Number of days simulated since the last reset.</summary>
+    /// <returns>the current simulation day</returns>
+    unsigned getDay() const { return day; }
+
+    /// <summary>
+    /// Draw every random decision from streams addressed by a key (see <c>HostMap::setRandomKey</c>).
+    /// </summary>
+    /// <param name="key">key identifying the replicate</param>
+    /// <remarks>
+    /// Decisions about individual hosts use the pathogen's keyed streams; the
+    /// engine of the count-based tiles is seeded from the key at each reset.
+    /// Call before <c>reset</c>.
+    /// </remarks>
+    void setRandomKey(uint64_t key) { disease.setKey(key); }
+
+    /// <summary>Return to independent random draws.</summary>
+    void clearRandomKey() { disease.clearKey(); }
+
+    /// <summary>Resets every tile to a fully susceptible, count-based population.</summary>
+    void reset()
+    {
+        gen.seed(static_cast<unsigned>(disease.seed(countTag)));
+        for (auto& t : tiles) {
+            t.individual = false;
+            t.hosts.clear();
+            t.hosts.shrink_to_fit();
+            t.count = Counts{ static_cast<uint32_t>(t.rows * t.cols), 0, 0, 0, 0 };
+        }
+        day = 0;
+    }
+
+    /// <summary>
+    /// Plant the disease in a given number of randomly chosen cells.
+    /// </summary>
+    /// <param name="count">number of infected individuals at the start of the simulation</param>
+    void seedDisease(int count)
+    {
+        std::uniform_int_distribution<int> di(0, rows - 1), dj(0, cols - 1);
+        for (auto attempts = 100 * count; count > 0 && attempts > 0; --attempts) {
+            if (expose(di(gen), dj(gen), 1.0, -1)) --count;
+        }
+    }
+
+    /// <summary>
+    /// Advance the simulation one time step (i.e., day).
+    /// </summary>
+    void computeNext()
+    {
+        disease.beginDay(day);
+        rebalance();
+
+        // Infectious hosts at the start of the day make today's contacts.
+        spreaders.clear();
+        for (auto& t : tiles) {
+            if (!t.individual || t.count[2] == 0) continue;
+            for (int k = 0; k < static_cast<int>(t.hosts.size()); ++k) {
+                auto& h = t.hosts[k];
+                if (disease.isInfectious(h)) {
+                    spreaders.push_back({ t.row0 + k / t.cols, t.col0 + k % t.cols, std::get<2>(h) });
+                }
+            }
+        }
+
+        // Prevalence snapshot used to couple count-based tiles.
+        prevalence.resize(tiles.size());
+        for (size_t k = 0; k < tiles.size(); ++k) {
+            auto n = tiles[k].alive();
+            prevalence[k] = n ? static_cast<double>(tiles[k].count[2]) / n : 0.0;
+        }
+
+        // Both representations progress before today's contacts, so that
+        // nobody infected today progresses today.
+        for (auto& t : tiles) {
+            if (t.individual && t.active() > 0) advanceHosts(t);
+        }
+        spillTo.clear();
+        spillMean.clear();
+        for (int k = 0; k < static_cast<int>(tiles.size()); ++k) {
+            if (!tiles[k].individual) advanceCounts(k);
+        }
+        for (auto& s : spreaders) {
+            spread(s[0], s[1], s[2]);
+        }
+
+        // One batched draw for the contacts of every count-based tile into its individual neighbors.
+        spillHits.resize(spillMean.size());
+        samplePoissonBatch(gen, spillMean.data(), spillHits.data(), spillMean.size());
+        for (size_t s = 0; s < spillHits.size(); ++s) {
+            spill(spillTo[s][0], spillTo[s][1], spillHits[s]);
+        }
+        ++day;
+    }
+
+    /// <summary>
+    /// Count the number of tiles currently simulated host by host.
+    /// </summary>
+    /// <returns>number of individual-based tiles</returns>
+    int countIndividualTiles() const
+    {
+        return static_cast<int>(std::count_if(tiles.begin(), tiles.end(),
+            [](Tile const& t) { return t.individual; }));
+    }
+
+    /// <summary>
+    /// Count the number of active infections.
+    /// </summary>
+    /// <returns>total number of exposed or infectious individuals in the map</returns>
+    long long countInfected() const { return total(1) + total(2); }
+
+    /// <summary>
+    /// Count the number of recovered individuals.
+    /// </summary>
+    /// <returns>total number of recovered individuals in the map</returns>
+    long long countRecovered() const { return total(3); }
+
+    /// <summary>
+    /// Count the number of deceased individuals.
+    /// </summary>
+    /// <returns>total number of dead individuals in the map</returns>
+    long long countDeceased() const { return total(4); }
+
+    /// <summary>
+    /// Print aggregate totals for the map so far.
+    /// </summary>
+    void printSummary() const
+    {
+        std::cout
+            << countDeceased() << " died, "
+            << countRecovered() << " recovered, "
+            << countInfected() << " still infected ("
+            << countIndividualTiles() << " of " << tiles.size() << " tiles individual)."
+            << std::endl;
+    }
+
+private:
+    static constexpr uint64_t countTag = 0x636f756e;      // "coun"
+
+    long long total(int c) const
+    {
+        long long n = 0;
+        for (auto& t : tiles) n += t.count[c];
+        return n;
+    }
+
+    static int compartment(Host const& h)
+    {
+        switch (std::get<0>(h)) {
+        case 0: return 0;
+        case 1: return 1;
+        case 2: return 2;
+        case 5: return 4;
+        default: return 3;
+        }
+    }
+
+    int tileOf(int i, int j) const { return (i / tile) * tileCols + j / tile; }
+
+    /// <summary>Row-major index in the grid of the <c>k</c>th host of an individual tile.</summary>
+    int index(Tile const& t, int k) const { return (t.row0 + k / t.cols) * cols + t.col0 + k % t.cols; }
+
+    double contactRadius() const
+    {
+        return (std::sqrt(disease.meanContacts() * disease.contactScale() + 2) - 1) / 2;
+    }
+
+    /// <summary>
+    /// Choose the representation of every tile from its prevalence and distance to the front.
+    /// </summary>
+    void rebalance()
+    {
+        std::vector<int> dist(tiles.size(), frontDistance + 1);
+        std::vector<int> frontier, next;
+        for (int k = 0; k < static_cast<int>(tiles.size()); ++k) {
+            auto& t = tiles[k];
+            auto n = t.alive();
+            if (t.active() > 0 && n > 0 && static_cast<double>(t.active()) / n < saturation) {
+                dist[k] = 0;
+                frontier.push_back(k);
+            }
+        }
+        for (int d = 1; d <= frontDistance && !frontier.empty(); ++d) {
+            next.clear();
+            for (auto k : frontier) {
+                auto ti = k / tileCols, tj = k % tileCols;
+                for (int di = -1; di <= 1; ++di) {
+                    for (int dj = -1; dj <= 1; ++dj) {
+                        auto n = ((ti + di + tileRows) % tileRows) * tileCols + (tj + dj + tileCols) % tileCols;
+                        if (dist[n] > d) {
+                            dist[n] = d;
+                            next.push_back(n);
+                        }
+                    }
+                }
+            }
+            frontier.swap(next);
+        }
+        for (size_t k = 0; k < tiles.size(); ++k) {
+            auto& t = tiles[k];
+            auto n = t.alive();
+            bool saturated = n > 0 && static_cast<double>(t.active()) / n >= saturation;
+            bool want = dist[k] <= frontDistance && !saturated;
+            if (want && !t.individual) materialize(t);
+            else if (!want && t.individual) {
+                t.individual = false;
+                t.hosts.clear();
+                t.hosts.shrink_to_fit();
+            }
+        }
+    }
+
+    /// <summary>
+    /// Scatter the counts of a tile over its cells as individual hosts.
+    /// </summary>
+    /// <remarks>
+    /// Exposed and infectious hosts get the residual time of their stage,
+    /// not a full new one: count-based tiles leave a stage at the daily rate
+    /// <c>1/mean</c>, which is memoryless, so the days left are geometric
+    /// with the same rate however long a host has already spent there.
+    /// </remarks>
+    void materialize(Tile& t)
+    {
+        static short const state[5] = { 0, 1, 2, 4, 5 };
+        t.hosts.clear();
+        for (int c = 0; c < 5; ++c) {
+            for (uint32_t n = 0; n < t.count[c]; ++n) {
+                t.hosts.emplace_back(state[c], 0, 0);
+            }
+        }
+        std::shuffle(t.hosts.begin(), t.hosts.end(), gen);
+        for (int k = 0; k < static_cast<int>(t.hosts.size()); ++k) {
+            auto& h = t.hosts[k];
+            disease.select(index(t, k), day);
+            if (disease.isExposed(h)) std::get<1>(h) = residual(disease.meanIncubation());
+            else if (disease.isInfectious(h)) std::get<1>(h) = residual(disease.meanInfection());
+            std::get<2>(h) = disease.numNeighbors();
+        }
+        t.individual = true;
+    }
+
+    /// <summary>
+    /// Draw the days left in a stage that is left at the daily rate <c>1/mean</c>.
+    /// </summary>
+    short residual(double mean)
+    {
+        std::geometric_distribution<int> d(1.0 / std::max(1.0, mean));
+        return static_cast<short>(std::min(1 + d(gen), 32767));
+    }
+
+    /// <summary>
+    /// Advance the infections of the hosts in an individual tile by one day.
+    /// </summary>
+    void advanceHosts(Tile& t)
+    {
+        for (int k = 0; k < static_cast<int>(t.hosts.size()); ++k) {
+            auto& h = t.hosts[k];
+            if (disease.isExposed(h) || disease.isInfectious(h)) {
+                disease.select(index(t, k), day);
+                auto before = compartment(h);
+                disease.worsen(h);
+                auto after = compartment(h);
+                --t.count[before];
+                ++t.count[after];
+            }
+        }
+    }
+
+    /// <summary>
+    /// Attempt to infect whoever occupies cell (i,j), in either representation.
+    /// </summary>
+    /// <param name="infector">row-major index of the infecting host, or -1 if none or count-based</param>
+    /// <returns><c>true</c> if a new infection occurred</returns>
+    bool expose(int i, int j, double p, int infector)
+    {
+        auto& t = tiles[tileOf(i, j)];
+        if (t.individual) {
+            auto& h = t.hosts[(i - t.row0) * t.cols + (j - t.col0)];
+            if (!disease.isSusceptible(h)) return false;
+            disease.select(i * cols + j, day, infector);
+            if (p < 1.0 && !disease.will_catch_p(p)) return false;
+            disease.infect(h);
+        }
+        else {
+            auto n = t.alive();
+            if (t.count[0] == 0 || sampleUniform(gen) * n >= t.count[0] * p) return false;
+        }
+        --t.count[0];
+        ++t.count[1];
+        return true;
+    }
+
+    /// <summary>
+    /// Identify and potentially infect the close contacts of individual (i,j).
+    /// </summary>
+    void spread(int i, int j, int contacts)
+    {
+        auto pE = disease.transmissionProbability();
+        auto scaled = contacts * disease.contactScale();
+        auto k = static_cast<int>(std::lround((std::sqrt(scaled + 1) - 1) / 2));
+        for (auto hi = i - k; hi <= i + k; ++hi) {
+            auto ri = (hi < 0) ? (rows + hi) : (hi >= rows ? (hi - rows) : hi);
+            for (auto hj = j - k; hj <= j + k; ++hj) {
+                auto cj = (hj < 0) ? (cols + hj) : (hj >= cols ? (hj - cols) : hj);
+                if (ri != i || cj != j) expose(ri, cj, pE, i * cols + j);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Advance a count-based tile by one day with a binomial chain, recording
+    /// the expected contacts that spill into neighboring individual tiles.
+    /// </summary>
+    void advanceCounts(int k)
+    {
+        auto& t = tiles[k];
+        auto ti = k / tileCols, tj = k % tileCols;
+        int const nbr[4] = {
+            ((ti + tileRows - 1) % tileRows) * tileCols + tj,
+            ((ti + 1) % tileRows) * tileCols + tj,
+            ti * tileCols + (tj + tileCols - 1) % tileCols,
+            ti * tileCols + (tj + 1) % tileCols
+        };
+        auto r = contactRadius();
+        auto share = std::min(0.25, r / (2.0 * tile));
+        auto p = (1 - 4 * share) * prevalence[k];
+        for (auto n : nbr) {
+            if (!tiles[n].individual) p += share * prevalence[n];
+        }
+        if (p <= 0 && t.active() == 0) return;
+
+        auto pE = disease.transmissionProbability();
+        auto kT = disease.meanContacts() * disease.contactScale();
+        auto I = t.count[2];
+        auto newE = sampleBinomial(gen, t.count[0], -std::expm1(std::log1p(-pE) * kT * p));
+        auto newI = sampleBinomial(gen, t.count[1], 1.0 / disease.meanIncubation());
+        auto done = sampleBinomial(gen, I, 1.0 / disease.meanInfection());
+        auto dead = sampleBinomial(gen, done, disease.deathProbability());
+        t.count[0] -= newE;
+        t.count[1] += newE - newI;
+        t.count[2] += newI - done;
+        t.count[3] += done - dead;
+        t.count[4] += dead;
+
+        if (I == 0) return;
+        for (int side = 0; side < 4; ++side) {
+            if (!tiles[nbr[side]].individual) continue;
+            spillTo.push_back({ k, side });
+            spillMean.push_back(static_cast<float>(I * kT * share * pE));
+        }
+    }
+
+    /// <summary>
+    /// Infect random hosts of an individual tile within the contact radius of its edge with a count-based tile.
+    /// </summary>
+    /// <param name="k">index of the count-based tile</param>
+    /// <param name="side">edge of tile <c>k</c>: top, bottom, left or right</param>
+    /// <param name="hits">number of infectious contacts across the edge</param>
+    void spill(int k, int side, uint32_t hits)
+    {
+        auto ti = k / tileCols, tj = k % tileCols;
+        auto n = side == 0 ? ((ti + tileRows - 1) % tileRows) * tileCols + tj
+            : side == 1 ? ((ti + 1) % tileRows) * tileCols + tj
+            : side == 2 ? ti * tileCols + (tj + tileCols - 1) % tileCols
+            : ti * tileCols + (tj + 1) % tileCols;
+        auto& u = tiles[n];
+        auto band = std::max(1, static_cast<int>(std::lround(contactRadius())));
+        for (uint32_t h = 0; h < hits; ++h) {
+            // Pick a cell of u within the band facing tile k.
+            auto w = std::min(band, side < 2 ? u.rows : u.cols);
+            auto along = static_cast<int>(sampleUniform(gen) * (side < 2 ? u.cols : u.rows));
+            auto depth = static_cast<int>(sampleUniform(gen) * w);
+            int i, j;
+            switch (side) {
+            case 0:  i = u.row0 + u.rows - 1 - depth; j = u.col0 + along; break;
+            case 1:  i = u.row0 + depth;              j = u.col0 + along; break;
+            case 2:  i = u.row0 + along;              j = u.col0 + u.cols - 1 - depth; break;
+            default: i = u.row0 + along;              j = u.col0 + depth; break;
+            }
+            expose(i, j, 1.0, -1);
+        }
+    }
+
+    Pathogen disease;
+    int rows;
+    int cols;
+    int tile;
+    int tileRows;
+    int tileCols;
+    int frontDistance;
+    double saturation;
+    std::vector<Tile> tiles;
+    std::vector<double> prevalence;
+    std::vector<std::array<int, 3>> spreaders;
+    std::vector<std::array<int, 2>> spillTo;      // count-based tile and side of each spill
+    std::vector<float> spillMean;                 // expected contacts of each spill
+    std::vector<uint32_t> spillHits;
+    std::default_random_engine gen;
+    unsigned day = 0;
+};
+
+#endif /*HPP_HYBRIDMAP*/
@@ -0,0 +1,223 @@
+#ifndef HPP_INFECTIONDAYRASTER
+#define HPP_INFECTIONDAYRASTER
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "hostmap.hpp"
+#include "parallel.hpp"
+
+/// <summary>
+/// Day on which each host was first infected, with analyses of the spreading front.
+/// </summary>
+/// <remarks>
+/// <para>
+/// The raster holds one 16-bit day per cell (<c>never</c> if the host has
+/// not been infected) and is written as infections are reported, so the
+/// run itself yields the arrival-time surface of the epidemic.
+/// </para>
+/// <para>
+/// <c>sectorFronts</c> finds, for each compass sector around an origin, the
+/// furthest distance reached by each day and fits the front speed.
+/// <c>regionSpeed</c> estimates the local speed inside a block as the
+/// reciprocal of the mean arrival-time gradient. Both are single parallel
+/// passes over row bands of the raster.
+/// </para>
+/// </remarks>
+class InfectionDayRaster : public InfectionObserver
+{
+public:
+    /// <summary>Marks a host that has never been infected.</summary>
+    static constexpr uint16_t never = 0xffff;
+
+    /// <summary>
+    /// Spread of the front in one direction.
+    /// </summary>
+    struct Front
+    {
+        std::vector<float> radius;  ///< furthest distance reached by the end of each day, in cells
+        double speed = 0.0;         ///< least-squares slope of the radius over time, in cells per day
+    };
+
+    /// <summary>
+    /// Initialize an empty raster for a map.
+    /// </summary>
+    /// <param name="map">the map to be observed</param>
+    InfectionDayRaster(HostMap const& map)
+        : rows(static_cast<int>(map.row_count())), cols(static_cast<int>(map.col_count())),
+        days(static_cast<size_t>(rows) * cols, uint16_t(never))
+    {}
+
+    void onInfection(unsigned day, int, int infectee) override
+    {
+        if (days[infectee] != never) return;
+        days[infectee] = static_cast<uint16_t>(day < never ? day : never - 1);
+        if (first < 0) first = infectee;
+        last = std::max(last, day);
+    }
+
+    void onReset() override
+    {
+        std::fill(days.begin(), days.end(), uint16_t(never));
+        first = -1;
+        last = 0;
+    }
+
+    /// <summary>
+    /// Day on which a host was first infected.
+    /// </summary>
+    /// <param name="k">row-major index of a host</param>
+    /// <returns>the day, or <c>never</c></returns>
+    uint16_t dayAt(size_t k) const { return days[k]; }
+
+    /// <summary>Row-major index of the first host infected, or -1 if none.</summary>
+    int origin() const { return first; }
+
+    /// <summary>
+    /// Write the raster as raw little-endian 16-bit values in row-major order.
+    /// </summary>
+    /// <param name="os">binary output stream</param>
+    void write(std::ostream& os) const
+    {
+        std::vector<unsigned char> buf(days.size() * 2);
+        for (size_t k = 0; k < days.size(); ++k) {
+            buf[2 * k] = static_cast<unsigned char>(days[k]);
+            buf[2 * k + 1] = static_cast<unsigned char>(days[k] >> 8);
+        }
+        os.write(reinterpret_cast<char const*>(buf.data()), buf.size());
+    }
+
+    /// <summary>
+    /// Position and speed of the front in each direction from an origin.
+    /// </summary>
+    /// <param name="origin">row-major index of the center, e.g., <c>origin()</c></param>
+    /// <param name="sectors">number of equal angular sectors, counter-clockwise from east</param>
+    /// <returns>one front per sector</returns>
+    /// <remarks>
+    /// Distances use the shortest displacement on the torus, so fronts are
+    /// meaningful until they reach halfway around the map.
+    /// </remarks>
+    std::vector<Front> sectorFronts(int origin, int sectors = 8) const
+    {
+        std::vector<Front> fronts(sectors);
+        if (origin < 0 || sectors <= 0) return fronts;
+        auto oi = origin / cols, oj = origin % cols;
+        auto span = static_cast<size_t>(last) + 1;
+        auto tau = 2 * 3.14159265358979323846;
+
+        // Furthest cell infected on each exact day, per sector and worker.
+        std::vector<std::vector<float>> reach(workerCount());
+        auto used = parallelFor(0, rows, [&](size_t lo, size_t hi, unsigned w) {
+            auto& r = reach[w];
+            r.assign(sectors * span, 0.0f);
+            for (auto i = static_cast<int>(lo); i < static_cast<int>(hi); ++i) {
+                auto di = wrap(i - oi, rows);
+                for (int j = 0; j < cols; ++j) {
+                    auto d = days[static_cast<size_t>(i) * cols + j];
+                    if (d == never) continue;
+                    auto dj = wrap(j - oj, cols);
+                    auto angle = std::atan2(-static_cast<double>(di), static_cast<double>(dj));
+                    if (angle < 0) angle += tau;
+                    auto s = std::min(static_cast<int>(angle / tau * sectors), sectors - 1);
+                    auto& cell = r[s * span + d];
+                    cell = std::max(cell, static_cast<float>(std::sqrt(double(di) * di + double(dj) * dj)));
+                }
+            }
+        });
+
+        for (int s = 0; s < sectors; ++s) {
+            auto& f = fronts[s];
+            f.radius.assign(span, 0.0f);
+            for (size_t d = 0; d < span; ++d) {
+                for (unsigned w = 0; w < used; ++w) f.radius[d] = std::max(f.radius[d], reach[w][s * span + d]);
+                if (d > 0) f.radius[d] = std::max(f.radius[d], f.radius[d - 1]);
+            }
+            f.speed = slope(f.radius);
+        }
+        return fronts;
+    }
+
+    /// <summary>
+    /// Local speed of the front within a block of cells.
+    /// </summary>
+    /// <param name="region">block of cells</param>
+    /// <returns>cells per day, or 0 if the front has not crossed the block</returns>
+    /// <remarks>
+    /// Uses central differences of the arrival day wherever a cell and its
+    /// four neighbors have all been infected.
+    /// </remarks>
+    double regionSpeed(Region region) const
+    {
+        auto r0 = std::max(region.row, 0), r1 = std::min(region.row + region.rows, rows);
+        auto c0 = std::max(region.col, 0), c1 = std::min(region.col + region.cols, cols);
+        if (r0 >= r1 || c0 >= c1) return 0.0;
+        std::vector<double> sums(workerCount(), 0.0);
+        std::vector<long> counts(sums.size(), 0);
+        parallelFor(r0, r1, [&](size_t lo, size_t hi, unsigned w) {
+            double sum = 0.0;
+            long n = 0;
+            for (auto i = static_cast<int>(lo); i < static_cast<int>(hi); ++i) {
+                auto up = (i == 0 ? rows : i) - 1, down = (i + 1 == rows ? 0 : i + 1);
+                for (int j = c0; j < c1; ++j) {
+                    auto left = (j == 0 ? cols : j) - 1, right = (j + 1 == cols ? 0 : j + 1);
+                    auto n0 = at(up, j), s0 = at(down, j), w0 = at(i, left), e0 = at(i, right);
+                    if (at(i, j) == never || n0 == never || s0 == never || w0 == never || e0 == never) continue;
+                    auto gi = (static_cast<double>(s0) - n0) / 2, gj = (static_cast<double>(e0) - w0) / 2;
+                    sum += std::sqrt(gi * gi + gj * gj);
+                    ++n;
+                }
+            }
+            sums[w] = sum;
+            counts[w] = n;
+        }, static_cast<unsigned>(sums.size()));
+        double sum = 0.0;
+        long n = 0;
+        for (size_t w = 0; w < sums.size(); ++w) {
+            sum += sums[w];
+            n += counts[w];
+        }
+        return (n && sum > 0) ? n / sum : 0.0;
+    }
+
+private:
+    uint16_t at(int i, int j) const { return days[static_cast<size_t>(i) * cols + j]; }
+
+    /// <summary>
+    /// Shortest signed displacement on a ring of length n.
+    /// </summary>
+    static int wrap(int d, int n)
+    {
+        if (d > n / 2) return d - n;
+        if (d < -n / 2) return d + n;
+        return d;
+    }
+
+    /// <summary>
+    /// Least-squares slope of a front over the days on which it was moving.
+    /// </summary>
+    static double slope(std::vector<float> const& radius)
+    {
+        size_t a = 0, b = radius.size();
+        while (a < b && radius[a] == 0.0f) ++a;
+        while (b > a + 1 && radius[b - 1] == radius[b - 2]) --b;
+        if (b - a < 2) return 0.0;
+        double n = static_cast<double>(b - a), sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (auto d = a; d < b; ++d) {
+            sx += d;
+            sy += radius[d];
+            sxx += double(d) * d;
+            sxy += d * radius[d];
+        }
+        return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    }
+
+    int rows;
+    int cols;
+    std::vector<uint16_t> days;
+    int first = -1;
+    unsigned last = 0;
+};
+
+#endif /*HPP_INFECTIONDAYRASTER*/
@@ -0,0 +1,200 @@
+#ifndef HPP_INFECTIONTREE
+#define HPP_INFECTIONTREE
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include "hostmap.hpp"
+
+/// <summary>
+/// Record of who infected whom, and on which day.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Infections reported by the map during a day are appended to a small
+/// buffer, which is merged into the history (or written out) when the day
+/// ends, so the contact pass only pays for one append per infection.
+/// </para>
+/// <para>
+/// The binary form is a 4-byte magic <c>GMIT</c> and a 32-bit version,
+/// followed by one block per day with infections: the day and the number of
+/// records (two 32-bit integers), then that many (infector, infectee) pairs
+/// of 32-bit row-major indices. All integers are little-endian. An infector
+/// of -1 marks a seeded or imported case.
+/// </para>
+/// <para>
+/// When streaming, each reset of the map writes a run marker: a block whose
+/// day is <c>0xFFFFFFFF</c> and whose count is the number of the run that
+/// starts (1, 2, ...), with no records. Run 0 holds any infections recorded
+/// before the first reset. Version 1 streams have no markers and are read
+/// as a single run 0.
+/// </para>
+/// </remarks>
+class InfectionTree : public InfectionObserver
+{
+public:
+    /// <summary>
+    /// A single transmission event.
+    /// </summary>
+    struct Record
+    {
+        uint32_t day;       ///< day during which the infection took place
+        int32_t infector;   ///< row-major index of the infecting host, or -1
+        int32_t infectee;   ///< row-major index of the newly exposed host
+        uint32_t run = 0;   ///< number of the run (see the run markers of the binary form)
+    };
+
+    /// <summary>
+    /// Initialize an empty tree, kept in memory.
+    /// </summary>
+    InfectionTree() = default;
+
+    /// <summary>
+    /// Initialize an empty tree that streams each day to a binary output.
+    /// </summary>
+    /// <param name="out">binary stream receiving the header and one block per day</param>
+    /// <remarks>
+    /// Records are not kept in memory in this mode, so memory use stays
+    /// bounded by the infections of a single day.
+    /// </remarks>
+    explicit InfectionTree(std::ostream& out) : out(&out) { writeHeader(out); }
+
+    void onInfection(unsigned day, int infector, int infectee) override
+    {
+        today.push_back({ day, infector, infectee });
+    }
+
+    void onDayEnd(HostMap const&) override { flush(); }
+
+    void onReset() override
+    {
+        today.clear();
+        history.clear();
+        if (out) {
+            writeWord(*out, runMarker);
+            writeWord(*out, ++runs);
+        }
+    }
+
+    /// <summary>
+    /// Merge the infections of the current day into the history (or the output stream).
+    /// </summary>
+    void flush()
+    {
+        if (today.empty()) return;
+        if (out) {
+            writeBlocks(*out, today);
+        }
+        else {
+            history.insert(history.end(), today.begin(), today.end());
+        }
+        today.clear();
+    }
+
+    /// <summary>
+    /// Transmission events recorded so far, in order of occurrence.
+    /// </summary>
+    /// <returns>the in-memory history (empty when streaming)</returns>
+    std::vector<Record> const& records() const { return history; }
+
+    /// <summary>
+    /// Write the in-memory history in binary form.
+    /// </summary>
+    /// <param name="os">binary output stream</param>
+    void write(std::ostream& os) const
+    {
+        writeHeader(os);
+        writeBlocks(os, history);
+    }
+
+    /// <summary>
+    /// Read a history previously written in binary form.
+    /// </summary>
+    /// <param name="is">binary input stream</param>
+    /// <returns>every record in the stream, in order</returns>
+    static std::vector<Record> read(std::istream& is)
+    {
+        char magic[4];
+        uint32_t version;
+        if (!is.read(magic, 4) || std::memcmp(magic, "GMIT", 4) != 0 || !readWord(is, version)
+            || version < 1 || version > 2) {
+            throw std::runtime_error("InfectionTree: not an infection tree stream");
+        }
+        std::vector<Record> result;
+        uint32_t day, count, run = 0;
+        while (readWord(is, day) && readWord(is, count)) {
+            if (day == runMarker && version >= 2) {
+                run = count;
+                continue;
+            }
+            for (uint32_t n = 0; n < count; ++n) {
+                uint32_t from, to;
+                if (!readWord(is, from) || !readWord(is, to)) {
+                    throw std::runtime_error("InfectionTree: truncated stream");
+                }
+                result.push_back({ day, static_cast<int32_t>(from), static_cast<int32_t>(to), run });
+            }
+        }
+        return result;
+    }
+
+private:
+    static constexpr uint32_t runMarker = 0xFFFFFFFFu;    // day field of a run marker block
+
+    static void writeHeader(std::ostream& os)
+    {
+        os.write("GMIT", 4);
+        writeWord(os, 2);
+    }
+
+    /// <summary>
+    /// Write records, grouped into one block per run of equal days.
+    /// </summary>
+    static void writeBlocks(std::ostream& os, std::vector<Record> const& recs)
+    {
+        std::vector<unsigned char> buf;
+        for (size_t a = 0; a < recs.size();) {
+            auto b = a;
+            while (b < recs.size() && recs[b].day == recs[a].day) ++b;
+            buf.clear();
+            put(buf, recs[a].day);
+            put(buf, static_cast<uint32_t>(b - a));
+            for (auto k = a; k < b; ++k) {
+                put(buf, static_cast<uint32_t>(recs[k].infector));
+                put(buf, static_cast<uint32_t>(recs[k].infectee));
+            }
+            os.write(reinterpret_cast<char const*>(buf.data()), buf.size());
+            a = b;
+        }
+    }
+
+    static void put(std::vector<unsigned char>& buf, uint32_t x)
+    {
+        for (int s = 0; s < 32; s += 8) buf.push_back(static_cast<unsigned char>(x >> s));
+    }
+
+    static void writeWord(std::ostream& os, uint32_t x)
+    {
+        std::vector<unsigned char> buf;
+        put(buf, x);
+        os.write(reinterpret_cast<char const*>(buf.data()), buf.size());
+    }
+
+    static bool readWord(std::istream& is, uint32_t& x)
+    {
+        unsigned char b[4];
+        if (!is.read(reinterpret_cast<char*>(b), 4)) return false;
+        x = b[0] | (b[1] << 8) | (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+        return true;
+    }
+
+    std::ostream* out = nullptr;
+    uint32_t runs = 0;          // run markers written so far
+    std::vector<Record> today;
+    std::vector<Record> history;
+};
+
+#endif /*HPP_INFECTIONTREE*/
@@ -0,0 +1,171 @@
+#ifndef HPP_INTERVENTION
+#define HPP_INTERVENTION
+
+#include <map>
+#include <vector>
+#include "hostmap.hpp"
+
+/// <summary>
+/// Kinds of action that an intervention may take on a region of the map.
+/// </summary>
+enum class Action
+{
+    Vaccinate,      ///< immunize a fraction (amount) of susceptible hosts
+    ImportCases,    ///< infect a number (amount) of susceptible hosts
+    ScaleContacts   ///< set the contact multiplier (amount) of the region, e.g., school closure
+};
+
+/// <summary>
+/// Running totals of a <c>HostMap</c> that may trigger an intervention.
+/// </summary>
+enum class Counter
+{
+    Infected,       ///< current exposed + infectious hosts
+    Infectious,     ///< current infectious hosts
+    Cumulative,     ///< hosts ever infected
+    Deceased,       ///< hosts killed by the disease
+    Quarantined     ///< infectious hosts currently isolated
+};
+
+/// <summary>
+/// A single region-targeted action.
+/// </summary>
+struct Intervention
+{
+    Action action;      ///< what to do
+    Region region;      ///< where to do it
+    double amount;      ///< coverage, case count or contact multiplier (see <c>Action</c>)
+};
+
+/// <summary>
+/// Day-indexed queue of interventions, plus threshold triggers that enqueue them.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Scheduled interventions are kept in a map keyed by day, so on days
+/// without events <c>apply</c> costs a single lookup. Triggers compare the
+/// map's incrementally maintained counters against a threshold and never
+/// scan hosts; once fired, a trigger enqueues its intervention after an
+/// optional delay and is discarded.
+/// </para>
+/// <para>
+/// Typical use is to call <c>advance</c> in place of <c>HostMap::computeNext</c>.
+/// </para>
+/// </remarks>
+class InterventionSchedule
+{
+public:
+    /// <summary>
+    /// Schedule an intervention on a specific day.
+    /// </summary>
+    /// <param name="day">simulation day on which to apply the intervention</param>
+    /// <param name="i">the intervention to apply</param>
+    void at(unsigned day, Intervention const& i) { queue[day].push_back(i); }
+
+    /// <summary>
+    /// Apply an intervention once a counter reaches a threshold.
+    /// </summary>
+    /// <param name="counter">running total to watch</param>
+    /// <param name="threshold">value at or above which the trigger fires</param>
+    /// <param name="i">the intervention to apply</param>
+    /// <param name="delay">days between the trigger firing and the intervention</param>
+    void when(Counter counter, int threshold, Intervention const& i, unsigned delay = 0)
+    {
+        triggers.push_back({ counter, threshold, delay, i });
+    }
+
+    /// <summary>
+    /// Fire any triggers and apply the interventions due on the map's current day.
+    /// </summary>
+    /// <param name="map">the simulated population</param>
+    /// <returns>number of interventions applied</returns>
+    int apply(HostMap& map)
+    {
+        auto today = map.getDay();
+        for (auto t = triggers.begin(); t != triggers.end();) {
+            if (read(map, t->counter) >= t->threshold) {
+                queue[today + t->delay].push_back(t->intervention);
+                t = triggers.erase(t);
+            }
+            else {
+                ++t;
+            }
+        }
+
+        int applied = 0;
+        while (!queue.empty() && queue.begin()->first <= today) {
+            for (auto& i : queue.begin()->second) {
+                perform(map, i);
+                ++applied;
+            }
+            queue.erase(queue.begin());
+        }
+        return applied;
+    }
+
+    /// <summary>
+    /// Apply today's interventions and then advance the simulation one day.
+    /// </summary>
+    /// <param name="map">the simulated population</param>
+    void advance(HostMap& map)
+    {
+        apply(map);
+        map.computeNext();
+    }
+
+    /// <summary>Whether any interventions or triggers remain.</summary>
+    /// <returns><c>true</c> if nothing is left to apply</returns>
+    bool empty() const { return queue.empty() && triggers.empty(); }
+
+    /// <summary>
+    /// Read one of the map's running totals.
+    /// </summary>
+    /// <param name="map">the simulated population</param>
+    /// <param name="counter">which total to read</param>
+    /// <returns>the current value of the counter</returns>
+    static int read(HostMap const& map, Counter counter)
+    {
+        switch (counter) {
+        case Counter::Infected:    return map.countInfected();
+        case Counter::Infectious:  return map.countInfectious();
+        case Counter::Cumulative:  return map.countCumulative();
+        case Counter::Deceased:    return map.countDeceased();
+        case Counter::Quarantined: return map.countQuarantined();
+        }
+        return 0;
+    }
+
+    /// <summary>
+    /// Carry out a single intervention on the map.
+    /// </summary>
+    /// <param name="map">the simulated population</param>
+    /// <param name="i">the intervention to apply</param>
+    static void perform(HostMap& map, Intervention const& i)
+    {
+        switch (i.action) {
+        case Action::Vaccinate:
+            map.vaccinate(i.region, i.amount);
+            break;
+        case Action::ImportCases:
+            map.importCases(i.region, static_cast<int>(i.amount));
+            break;
+        case Action::ScaleContacts:
+            map.setContactScale(i.region, static_cast<float>(i.amount));
+            break;
+        }
+    }
+
+private:
+    struct Trigger
+    {
+        Counter counter;
+        int threshold;
+        unsigned delay;
+        Intervention intervention;
+    };
+
+    std::map<unsigned, std::vector<Intervention>> queue;
+    std::vector<Trigger> triggers;
+};
+
+#endif /*HPP_INTERVENTION*/
@@ -0,0 +1,323 @@
+#ifndef HPP_METAPOPULATION
+#define HPP_METAPOPULATION
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "counterrng.hpp"
+#include "hostmap.hpp"
+#include "sampling.hpp"
+
+/// <summary>
+/// Metapopulation engine: each grid cell holds S/E/I/R/D counts for a local population.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Each day advances every cell with a binomial chain (tau-leaping). A
+/// susceptible person in cell <c>c</c> is infected with probability
+/// <c>1 - (1 - pE)^(kT * p)</c>, where <c>p</c> is the infectious fraction
+/// of the cell blended with that of its four neighbors by the coupling
+/// strength. Exposed and infectious people progress with daily
+/// probabilities equal to the reciprocal of the pathogen's mean incubation
+/// and infection periods (i.e., the geometric dwell times of <c>Pathogen</c>
+/// without the minimum delay), and resolved infections die with probability <c>pD</c>.
+/// </para>
+/// <para>
+/// Counts are stored as separate 32-bit columns in row-major order and
+/// the day is processed in parallel row bands (see <c>parallelFor</c>). Each
+/// row draws from its own stream, seeded from the pathogen (see
+/// <c>Pathogen::seed</c>), so results do not depend on the number of threads
+/// and are reproducible in paired mode. Per-row flags let both passes skip
+/// rows with no infectious people within one row and no active infections.
+/// </para>
+/// </remarks>
+class MetaMap
+{
+public:
+    /// <summary>
+    /// Initialize this map with a uniform population.
+    /// </summary>
+    /// <param name="disease">representation of a communicable disease</param>
+    /// <param name="r">number of rows in the grid</param>
+    /// <param name="c">number of columns in the grid</param>
+    /// <param name="perCell">number of people in each cell</param>
+    /// <param name="coupling">fraction of contacts made with the four neighboring cells</param>
+    MetaMap(Pathogen const& disease, int r = 100, int c = 100, uint32_t perCell = 1000,
+        double coupling = 0.1)
+        : disease(disease), rows(r), cols(c), coupling(coupling),
+        S(static_cast<size_t>(r) * c, perCell), E(S.size(), 0), I(S.size(), 0),
+        R(S.size(), 0), D(S.size(), 0), force(S.size(), 0.0f),
+        infectiousRows(r, 0), activeRows(r, 0), forcedRows(r, 0)
+    {
+        reset();
+    }
+
+    /// <summary>Width of the the map.</summary>
+    /// <returns>number of columns in the grid</returns>
+    size_t col_count() const { return cols; }
+
+    /// <summary>Height of the the map.</summary>
+    /// <returns>number of rows in the grid</returns>
+    size_t row_count() const { return rows; }
+
+    /// <summary>Number of days simulated since the last reset.</summary>
+    /// <returns>the current simulation day</returns>
+    unsigned getDay() const { return day; }
+
+    /// <summary>
+    /// Set the population of each cell from a density raster.
+    /// </summary>
+    /// <param name="params">raster layers aligned with the grid</param>
+    /// <param name="maxPerCell">number of people in a cell of density 1</param>
+    void setPopulation(SpatialParameters const& params, uint32_t maxPerCell)
+    {
+        if (!params.fits(rows, cols)) {
+            throw std::invalid_argument("MetaMap: raster layers do not match the grid size");
+        }
+        for (size_t k = 0; k < S.size(); ++k) {
+            auto n = std::lround(params.populationDensity(k) * maxPerCell);
+            S[k] = static_cast<uint32_t>(n > 0 ? n : 0);
+            E[k] = I[k] = R[k] = D[k] = 0;
+        }
+        reset(false);
+    }
+
+    /// <summary>
+    /// Draw every random decision from streams addressed by a key (see <c>HostMap::setRandomKey</c>).
+    /// </summary>
+    /// <param name="key">key identifying the replicate</param>
+    void setRandomKey(uint64_t key) { disease.setKey(key); }
+
+    /// <summary>Return to independent random draws.</summary>
+    void clearRandomKey() { disease.clearKey(); }
+
+    /// <summary>Resets every cell to a fully susceptible population.</summary>
+    void reset() { reset(true); }
+
+    /// <summary>
+    /// Plant the disease in a given number of people in randomly chosen cells.
+    /// </summary>
+    /// <param name="count">number of infected people at the start of the simulation</param>
+    void seedDisease(int count)
+    {
+        CounterEngine gen(disease.seed(mixKey(seedingTag, seedings++)));
+        std::uniform_int_distribution<size_t> d(0, S.size() - 1);
+        for (auto attempts = 100 * count; count > 0 && attempts > 0; --attempts) {
+            auto k = d(gen);
+            if (S[k] == 0) continue;
+            --S[k];
+            ++E[k];
+            activeRows[k / cols] = 1;
+            --susceptible;
+            ++exposed;
+            --count;
+        }
+    }
+
+    /// <summary>
+    /// Advance the simulation one time step (i.e., day).
+    /// </summary>
+    void computeNext()
+    {
+        disease.beginDay(day);
+        auto logq = std::log1p(-disease.transmissionProbability())
+            * disease.meanContacts() * disease.contactScale();
+        auto workers = workerCount();
+        parallelFor(0, rows, [&](size_t lo, size_t hi, unsigned) {
+            for (auto i = lo; i < hi; ++i) {
+                auto up = (i == 0 ? rows : i) - 1, down = (i + 1 == rows ? 0 : i + 1);
+                if (!infectiousRows[up] && !infectiousRows[i] && !infectiousRows[down]) {
+                    if (forcedRows[i]) {
+                        std::fill(force.begin() + i * cols, force.begin() + (i + 1) * cols, 0.0f);
+                        forcedRows[i] = 0;
+                    }
+                    continue;
+                }
+                for (size_t j = 0; j < cols; ++j) {
+                    auto p = prevalence(i, j);
+                    force[i * cols + j] = p > 0 ? static_cast<float>(-std::expm1(logq * p)) : 0.0f;
+                }
+                forcedRows[i] = 1;
+            }
+        }, workers);
+
+        auto sigma = 1.0 / disease.meanIncubation();
+        auto gamma = 1.0 / disease.meanInfection();
+        auto pD = disease.deathProbability();
+        auto seed = disease.seed(mixKey(stepTag, day));
+        std::vector<std::array<int64_t, 5>> deltas(workers, std::array<int64_t, 5>{});
+        parallelFor(0, rows, [&](size_t lo, size_t hi, unsigned w) {
+            auto& delta = deltas[w];
+            for (auto i = lo; i < hi; ++i) {
+                if (!forcedRows[i] && !activeRows[i]) continue;
+                CounterEngine gen(mixKey(seed, i));
+                uint32_t sick = 0, active = 0;
+                for (auto k = i * cols; k < (i + 1) * cols; ++k) {
+                    if (force[k] == 0.0f && E[k] == 0 && I[k] == 0) continue;
+                    advance(gen, k, sigma, gamma, pD, delta);
+                    sick |= I[k];
+                    active |= E[k] | I[k];
+                }
+                infectiousRows[i] = sick != 0;
+                activeRows[i] = active != 0;
+            }
+        }, workers);
+
+        for (auto& delta : deltas) {
+            susceptible += delta[0];
+            exposed += delta[1];
+            infectious += delta[2];
+            recovered += delta[3];
+            deceased += delta[4];
+        }
+        ++day;
+    }
+
+    /// <summary>Susceptible people in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t susceptibleAt(size_t k) const { return S[k]; }
+
+    /// <summary>Exposed people in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t exposedAt(size_t k) const { return E[k]; }
+
+    /// <summary>Infectious people in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t infectiousAt(size_t k) const { return I[k]; }
+
+    /// <summary>Recovered people in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t recoveredAt(size_t k) const { return R[k]; }
+
+    /// <summary>Deceased people in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t deceasedAt(size_t k) const { return D[k]; }
+
+    /// <summary>
+    /// Count the number of susceptible people.
+    /// </summary>
+    /// <returns>total susceptible population of the map</returns>
+    int64_t countSusceptible() const { return susceptible; }
+
+    /// <summary>
+    /// Count the number of active infections.
+    /// </summary>
+    /// <returns>total number of exposed or infectious people in the map</returns>
+    int64_t countInfected() const { return exposed + infectious; }
+
+    /// <summary>
+    /// Count the number of recovered people.
+    /// </summary>
+    /// <returns>total number of recovered people in the map</returns>
+    int64_t countRecovered() const { return recovered; }
+
+    /// <summary>
+    /// Count the number of deceased people.
+    /// </summary>
+    /// <returns>total number of dead people in the map</returns>
+    int64_t countDeceased() const { return deceased; }
+
+    /// <summary>
+    /// Print aggregate totals for the map so far.
+    /// </summary>
+    void printSummary() const
+    {
+        std::cout
+            << countDeceased() << " died, "
+            << countRecovered() << " recovered, "
+            << countInfected() << " still infected."
+            << std::endl;
+    }
+
+private:
+    /// <summary>
+    /// Infectious fraction seen by a person in cell (i,j), including coupling to neighbors.
+    /// </summary>
+    double prevalence(size_t i, size_t j) const
+    {
+        auto up = (i == 0 ? rows : i) - 1, down = (i + 1 == rows ? 0 : i + 1);
+        auto left = (j == 0 ? cols : j) - 1, right = (j + 1 == cols ? 0 : j + 1);
+        auto local = fraction(i * cols + j);
+        if (coupling <= 0) return local;
+        auto nbrs = fraction(up * cols + j) + fraction(down * cols + j)
+            + fraction(i * cols + left) + fraction(i * cols + right);
+        return (1 - coupling) * local + coupling * nbrs / 4;
+    }
+
+    double fraction(size_t k) const
+    {
+        if (I[k] == 0) return 0.0;
+        return static_cast<double>(I[k]) / (static_cast<double>(S[k]) + E[k] + I[k] + R[k]);
+    }
+
+    /// <summary>
+    /// Advance cell <c>k</c> one day with a binomial chain, accumulating the changes of the totals.
+    /// </summary>
+    void advance(CounterEngine& gen, size_t k, double sigma, double gamma, double pD,
+        std::array<int64_t, 5>& delta)
+    {
+        auto newE = sampleBinomial(gen, S[k], force[k]);
+        auto newI = sampleBinomial(gen, E[k], sigma);
+        auto done = sampleBinomial(gen, I[k], gamma);
+        auto dead = sampleBinomial(gen, done, pD);
+        S[k] -= newE;
+        E[k] += newE - newI;
+        I[k] += newI - done;
+        R[k] += done - dead;
+        D[k] += dead;
+        delta[0] -= newE;
+        delta[1] += static_cast<int64_t>(newE) - newI;
+        delta[2] += static_cast<int64_t>(newI) - done;
+        delta[3] += done - dead;
+        delta[4] += dead;
+    }
+
+    void reset(bool uniform)
+    {
+        susceptible = exposed = infectious = recovered = deceased = 0;
+        for (size_t k = 0; k < S.size(); ++k) {
+            if (uniform) {
+                S[k] += E[k] + I[k] + R[k] + D[k];
+                E[k] = I[k] = R[k] = D[k] = 0;
+            }
+            susceptible += S[k];
+        }
+        std::fill(force.begin(), force.end(), 0.0f);
+        std::fill(infectiousRows.begin(), infectiousRows.end(), 0);
+        std::fill(activeRows.begin(), activeRows.end(), 0);
+        std::fill(forcedRows.begin(), forcedRows.end(), 0);
+        day = 0;
+        seedings = 0;
+    }
+
+    static constexpr uint64_t stepTag = 0x73746570;       // "step"
+    static constexpr uint64_t seedingTag = 0x73656564;    // "seed"
+
+    Pathogen disease;
+    size_t rows;
+    size_t cols;
+    double coupling;
+    std::vector<uint32_t> S;
+    std::vector<uint32_t> E;
+    std::vector<uint32_t> I;
+    std::vector<uint32_t> R;
+    std::vector<uint32_t> D;
+    std::vector<float> force;
+    // A row whose flag is clear holds no such cell.
+    std::vector<uint8_t> infectiousRows;    // rows with infectious people
+    std::vector<uint8_t> activeRows;        // rows with exposed or infectious people
+    std::vector<uint8_t> forcedRows;        // rows with nonzero force of infection
+    int64_t susceptible = 0;
+    int64_t exposed = 0;
+    int64_t infectious = 0;
+    int64_t recovered = 0;
+    int64_t deceased = 0;
+    unsigned day = 0;
+    unsigned seedings = 0;                  // seedDisease calls since the last reset
+};
+
+#endif /*HPP_METAPOPULATION*/
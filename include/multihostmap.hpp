@@ -0,0 +1,391 @@
+#ifndef HPP_MULTIHOSTMAP
+#define HPP_MULTIHOSTMAP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "counterrng.hpp"
+#include "pathogen.hpp"
+
+/// <summary>
+/// Packed per-host record holding one <c>Host</c> state for each of
+/// <c>N</c> co-circulating pathogens (storage upper-bound = 6*N*P Bytes).
+/// </summary>
+template <std::size_t N>
+using MultiHost = std::array<Host, N>;
+
+/// <summary>
+/// Rectangular grid of host individuals exposed to several diseases at once.
+/// </summary>
+/// <remarks>
+/// <para>
+/// All pathogens share one packed record per host, so the map takes half
+/// (or less) of the memory of one <c>HostMap</c> per pathogen. Each day is a
+/// single sweep, in row-major order, over the hosts with any active (exposed
+/// or infectious) infection, advancing every pathogen of a host in the same
+/// visit, so its cost follows the outbreaks rather than the grid size.
+/// </para>
+/// <para>
+/// An interaction sees a host as left by the sweep so far: hosts before the
+/// infector in row-major order have already been advanced for the day.
+/// </para>
+/// <para>
+/// Pathogens may optionally interact. Cross-immunity <c>(a,b)</c> is the
+/// probability that a host recovered from <c>a</c> resists infection by
+/// <c>b</c>; interference <c>(a,b)</c> is the probability that an active
+/// (exposed or infectious) infection with <c>a</c> blocks infection by
+/// <c>b</c>. Both default to zero, i.e., independent co-circulation.
+/// </para>
+/// </remarks>
+template <std::size_t N>
+class MultiHostMap : public std::vector<std::vector<MultiHost<N>>>
+{
+    using cell_type = MultiHost<N>;
+    using row_type = std::vector<cell_type>;
+    using super = std::vector<row_type>;
+
+    std::array<Pathogen, N> diseases;
+    std::array<std::array<double, N>, N> crossImmunity{};
+    std::array<std::array<double, N>, N> interference{};
+    bool interacting = false;
+    std::vector<int> active;                    // hosts exposed to or infectious with any pathogen, ascending
+    std::vector<int> joined;                    // hosts that became active during the current day
+    std::array<int, N> infected{};              // hosts exposed to or infectious with each pathogen
+    int current = -1;                           // host being visited by computeNext
+    unsigned day = 0;
+
+    static thread_local std::default_random_engine rng;   // one engine per thread, so maps can run concurrently
+    mutable CounterEngine blocking;             // keyed stream for cross-immunity and interference
+    mutable std::uniform_real_distribution<double> udist{ 0.0, 1.0 };
+    unsigned seedings = 0;                      // seedDisease calls since the last reset
+
+    static constexpr uint64_t blockingTag = 0x626c6f63;   // "bloc"
+    static constexpr uint64_t seedingTag = 0x73656564;    // "seed"
+
+public:
+    /// <summary>
+    /// Initialize this map with the specified dimensions and diseases.
+    /// </summary>
+    /// <param name="diseases">representations of the co-circulating diseases</param>
+    /// <param name="r">number of rows in the grid</param>
+    /// <param name="c">number of columns in the grid</param>
+    MultiHostMap(std::array<Pathogen, N> const& diseases, int r = 100, int c = 100)
+        : super(r, row_type(c)), diseases(diseases)
+    {
+        reset();
+    }
+
+    /// <summary>Width of the the map.</summary>
+    /// <returns>number of columns in the grid</returns>
+    size_t col_count() const { return (*this)[0].size(); }
+
+    /// <summary>Height of the the map.</summary>
+    /// <returns>number of rows in the grid</returns>
+    size_t row_count() const { return this->size(); }
+
+    /// <summary>Number of co-circulating pathogens.</summary>
+    /// <returns>the pathogen count <c>N</c></returns>
+    static constexpr size_t pathogen_count() { return N; }
+
+    /// <summary>Number of days simulated since the last reset.</summary>
+    /// <returns>the current simulation day</returns>
+    unsigned getDay() const { return day; }
+
+    /// <summary>Access one of the modeled diseases.</summary>
+    /// <param name="k">index of a pathogen</param>
+    /// <returns>the <c>k</c>th disease</returns>
+    Pathogen const& disease(size_t k) const { return diseases[k]; }
+
+    /// <summary>
+    /// Set the probability that recovery from one pathogen protects against another.
+    /// </summary>
+    /// <param name="a">index of the pathogen from which the host recovered</param>
+    /// <param name="b">index of the pathogen attempting infection</param>
+    /// <param name="p">probability that the exposure is resisted</param>
+    void setCrossImmunity(size_t a, size_t b, double p)
+    {
+        crossImmunity[a][b] = p;
+        interacting = interacting || p > 0;
+    }
+
+    /// <summary>
+    /// Set the probability that an active infection blocks another pathogen.
+    /// </summary>
+    /// <param name="a">index of the pathogen currently infecting the host</param>
+    /// <param name="b">index of the pathogen attempting infection</param>
+    /// <param name="p">probability that the exposure is blocked</param>
+    void setInterference(size_t a, size_t b, double p)
+    {
+        interference[a][b] = p;
+        interacting = interacting || p > 0;
+    }
+
+    /// <summary>
+    /// Draw every random decision from streams addressed by a key (see <c>HostMap::setRandomKey</c>).
+    /// </summary>
+    /// <param name="key">key identifying the replicate</param>
+    /// <remarks>
+    /// Each pathogen gets its own key derived from this one. Call before <c>reset</c>.
+    /// </remarks>
+    void setRandomKey(uint64_t key)
+    {
+        for (size_t k = 0; k < N; ++k) diseases[k].setKey(mixKey(key, k));
+    }
+
+    /// <summary>Return to independent random draws.</summary>
+    void clearRandomKey()
+    {
+        for (auto& d : diseases) d.clearKey();
+    }
+
+    /// <summary>Resets the data for all hosts in the map.</summary>
+    void reset()
+    {
+        active.clear();
+        joined.clear();
+        infected.fill(0);
+        day = 0;
+        seedings = 0;
+        for (auto& d : diseases) d.beginDay(day);
+        auto C = static_cast<int>(col_count());
+        for (int i = 0; i < static_cast<int>(row_count()); ++i) {
+            auto& row = (*this)[i];
+            for (int j = 0; j < C; ++j) {
+                for (size_t k = 0; k < N; ++k) {
+                    diseases[k].select(i * C + j);
+                    row[j][k] = std::make_tuple<short, short, short>(0, 0, diseases[k].numNeighbors());
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Provides a view of the grid as a torus topology.
+    /// </summary>
+    /// <param name="i">a row index</param>
+    /// <param name="j">a column index</param>
+    /// <returns>a cell from the grid</returns>
+    cell_type& getNeighbor(int i, int j)
+    {
+        auto R = static_cast<int>(row_count());
+        auto C = static_cast<int>(col_count());
+
+        i = (i < 0) ? (R + i) : (i >= R ? (i - R) : i);
+        j = (j < 0) ? (C + j) : (j >= C ? (j - C) : j);
+        return (*this)[i][j];
+    }
+
+    /// <summary>
+    /// Determine whether another infection state of a host prevents infection by pathogen <c>b</c>.
+    /// </summary>
+    /// <param name="x">a potential host in the population</param>
+    /// <param name="b">index of the pathogen attempting infection</param>
+    /// <returns><c>true</c> if cross-immunity or interference blocks the infection</returns>
+    bool isBlocked(cell_type const& x, size_t b) const
+    {
+        for (size_t a = 0; a < N; ++a) {
+            if (a == b) continue;
+            auto& d = diseases[a];
+            double p = d.isRecovered(x[a]) ? crossImmunity[a][b]
+                : (d.isExposed(x[a]) || d.isInfectious(x[a])) ? interference[a][b]
+                : 0.0;
+            if (p > 0 && (diseases[b].isKeyed() ? udist(blocking) : udist(rng)) < p) return true;
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Identify and potentially infect the close contacts of individual (i,j) with pathogen <c>k</c>.
+    /// </summary>
+    /// <param name="i">row position of a host in the grid</param>
+    /// <param name="j">column position of a host in the grid</param>
+    /// <param name="k">index of the pathogen being spread</param>
+    void computeContacts(int i, int j, size_t k)
+    {
+        auto& disease = diseases[k];
+        auto R = static_cast<int>(row_count());
+        auto C = static_cast<int>(col_count());
+        auto t = std::get<2>((*this)[i][j][k]) * disease.contactScale();
+        auto r = static_cast<int>(std::lround((std::sqrt(t + 1) - 1) / 2));
+        for (auto hi = i - r; hi <= i + r; ++hi) {
+            auto ri = (hi < 0) ? (R + hi) : (hi >= R ? (hi - R) : hi);
+            for (auto hj = j - r; hj <= j + r; ++hj) {
+                auto cj = (hj < 0) ? (C + hj) : (hj >= C ? (hj - C) : hj);
+                auto& x = (*this)[ri][cj];
+                if (!disease.isSusceptible(x[k])) continue;
+                disease.select(ri * C + cj, day, i * C + j);
+                if (disease.will_catch()) {
+                    if (interacting && disease.isKeyed()) {
+                        blocking.seek(mixKey(mixKey(disease.seed(blockingTag), day), static_cast<uint64_t>(ri * C + cj)));
+                    }
+                    if (!interacting || !isBlocked(x, k)) infect(ri * C + cj, k);
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Advance every pathogen one time step (i.e., day).
+    /// </summary>
+    /// <remarks>
+    /// Hosts infected during the day only progress from the next day: a host
+    /// that becomes active is merged into the active list at the end of the
+    /// day, and a new infection of a host still ahead in the sweep starts one
+    /// day longer, which its visit takes back. Transmission and contact
+    /// forcing of every pathogen are evaluated once at the start of the day.
+    /// </remarks>
+    void computeNext()
+    {
+        auto C = static_cast<int>(col_count());
+        for (auto& d : diseases) d.beginDay(day);
+        for (auto x : active) {
+            current = x;
+            auto i = x / C, j = x % C;
+            auto& cell = (*this)[i][j];
+            for (size_t k = 0; k < N; ++k) {
+                auto& disease = diseases[k];
+                if (!isActive(cell, k)) continue;
+                auto spreading = disease.isInfectious(cell[k]);
+                disease.select(x, day);
+                disease.worsen(cell[k]);
+                if (!isActive(cell, k)) --infected[k];
+                if (spreading) computeContacts(i, j, k);
+            }
+        }
+        current = -1;
+
+        active.erase(std::remove_if(active.begin(), active.end(), [&](int x) {
+            return !isActive((*this)[x / C][x % C]);
+        }), active.end());
+        merge();
+        ++day;
+    }
+
+    /// <summary>
+    /// Count the number of active infections of one pathogen.
+    /// </summary>
+    /// <param name="k">index of a pathogen</param>
+    /// <returns>total number of hosts infected by pathogen <c>k</c></returns>
+    int countInfected(size_t k) const { return infected[k]; }
+
+    /// <summary>
+    /// Count the number of hosts with any active infection.
+    /// </summary>
+    /// <returns>total number of hosts infected by at least one pathogen</returns>
+    int countInfected() const { return static_cast<int>(active.size()); }
+
+    /// <summary>
+    /// Count the number of individuals recovered from one pathogen.
+    /// </summary>
+    /// <param name="k">index of a pathogen</param>
+    /// <returns>total number of hosts recovered from pathogen <c>k</c></returns>
+    int countRecovered(size_t k) const
+    {
+        return count(k, [](Pathogen const& d, Host const& h) { return d.isRecovered(h); });
+    }
+
+    /// <summary>
+    /// Count the number of individuals killed by one pathogen.
+    /// </summary>
+    /// <param name="k">index of a pathogen</param>
+    /// <returns>total number of hosts killed by pathogen <c>k</c></returns>
+    int countDeceased(size_t k) const
+    {
+        return count(k, [](Pathogen const& d, Host const& h) { return d.isDeceased(h); });
+    }
+
+    /// <summary>
+    /// Print aggregate totals for each pathogen so far.
+    /// </summary>
+    void printSummary() const
+    {
+        for (size_t k = 0; k < N; ++k) {
+            std::cout
+                << diseases[k].getName() << ": "
+                << countDeceased(k) << " died, "
+                << countRecovered(k) << " recovered, "
+                << countInfected(k) << " still infected."
+                << std::endl;
+        }
+    }
+
+    /// <summary>
+    /// Plant one pathogen in a given number of individuals.
+    /// </summary>
+    /// <param name="k">index of the pathogen to plant</param>
+    /// <param name="count">number of infected individuals at the start of the simulation</param>
+    void seedDisease(size_t k, int count)
+    {
+        CounterEngine gen(diseases[k].seed(mixKey(seedingTag, seedings++)));
+        std::uniform_int_distribution<> d(0, static_cast<int>(row_count() * col_count()) - 1);
+        while (count--) {
+            auto  x = static_cast<size_t>(d(gen));
+            auto& cell = (*this)[x / col_count()][x % col_count()];
+            diseases[k].select(static_cast<int>(x), day);
+            if (isActive(cell, k)) diseases[k].infect(cell[k]);
+            else infect(static_cast<int>(x), k);
+        }
+        merge();
+    }
+
+private:
+    bool isActive(cell_type const& cell, size_t k) const
+    {
+        return diseases[k].isExposed(cell[k]) || diseases[k].isInfectious(cell[k]);
+    }
+
+    bool isActive(cell_type const& cell) const
+    {
+        for (size_t k = 0; k < N; ++k) {
+            if (isActive(cell, k)) return true;
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Infect a host that is not active with pathogen <c>k</c>, keeping the active list in step.
+    /// </summary>
+    /// <param name="x">row-major index of the host</param>
+    /// <param name="k">index of the pathogen</param>
+    void infect(int x, size_t k)
+    {
+        auto C = static_cast<int>(col_count());
+        auto& cell = (*this)[x / C][x % C];
+        auto listed = std::binary_search(active.begin(), active.end(), x);
+        if (!listed && !isActive(cell)) joined.push_back(x);
+        diseases[k].infect(cell[k]);
+        ++infected[k];
+        if (listed && x > current) ++std::get<1>(cell[k]);
+    }
+
+    /// <summary>Merge the hosts that became active into the active list.</summary>
+    void merge()
+    {
+        std::sort(joined.begin(), joined.end());
+        auto middle = active.size();
+        active.insert(active.end(), joined.begin(), joined.end());
+        std::inplace_merge(active.begin(), active.begin() + middle, active.end());
+        joined.clear();
+    }
+
+    template <typename Predicate>
+    int count(size_t k, Predicate pred) const
+    {
+        int count = 0;
+        for (auto& row : *this) {
+            for (auto& cell : row) {
+                if (pred(diseases[k], cell[k])) ++count;
+            }
+        }
+        return count;
+    }
+};
+
+template <std::size_t N>
+thread_local std::default_random_engine MultiHostMap<N>::rng{ std::random_device()() };
+
+#endif /*HPP_MULTIHOSTMAP*/
@@ -0,0 +1,48 @@
+#ifndef HPP_PARALLEL
+#define HPP_PARALLEL
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Number of worker threads to use for parallel passes over a map.
+/// </summary>
+/// <returns>the hardware concurrency, or 1 if it cannot be determined</returns>
+inline unsigned workerCount()
+{
+    auto n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+/// <summary>
+/// Split an index range into contiguous bands and process each band on its own thread.
+/// </summary>
+/// <param name="begin">first index of the range</param>
+/// <param name="end">one past the last index of the range</param>
+/// <param name="fn">callable as <c>fn(lo, hi, worker)</c> for the band <c>[lo, hi)</c></param>
+/// <param name="workers">maximum number of threads (0 for <c>workerCount()</c>)</param>
+/// <returns>the number of bands (and distinct worker indices) used</returns>
+/// <remarks>
+/// Bands are handed out in order, so worker <c>w</c> always receives a lower
+/// band than worker <c>w+1</c>. The calling thread processes the last band.
+/// </remarks>
+template <typename F>
+unsigned parallelFor(size_t begin, size_t end, F fn, unsigned workers = 0)
+{
+    if (end <= begin) return 0;
+    auto n = end - begin;
+    auto w = static_cast<size_t>(workers ? workers : workerCount());
+    w = std::min(w, n);
+    std::vector<std::thread> threads;
+    threads.reserve(w - 1);
+    for (size_t t = 0; t + 1 < w; ++t) {
+        threads.emplace_back(fn, begin + n * t / w, begin + n * (t + 1) / w, static_cast<unsigned>(t));
+    }
+    fn(begin + n * (w - 1) / w, end, static_cast<unsigned>(w - 1));
+    for (auto& t : threads) t.join();
+    return static_cast<unsigned>(w);
+}
+
+#endif /*HPP_PARALLEL*/
@@ -13,8 +13,15 @@
 #ifndef HPP_PATHOGEN
 #define HPP_PATHOGEN
 
+#include <array>
+#include <cstdint>
 #include <random>
+#include <string>
 #include <tuple>
+#include <utility>
+#include "counterrng.hpp"
+#include "forcing.hpp"
+#include "sampling.hpp"
 
 // 
 
@@ -29,6 +36,8 @@
 /// - resolved = 3
 /// - recovered = 4
 /// - deceased = 5
+/// - vacant (no host in this cell) = 6
+/// - immune (vaccinated) = 7
 /// Days remaining (2nd elem):
 /// - incubation = [1,kE]
 /// - infection = [1,kI]
@@ -69,6 +78,11 @@ using Host = std::tuple<short, short, short>;
 class Pathogen
 {
 public:
+    /// <summary>
+    /// Kinds of random decision, each drawn from its own stream in paired mode.
+    /// </summary>
+    enum Purpose { Transmission, Incubation, Infection, Death, Contacts, PurposeCount };
+
     /// <summary>
     /// Initialize this disease.
     /// </summary>
@@ -80,15 +94,100 @@ public:
     /// <param name="minI">minimum days duration of infection</param>
     /// <param name="kI">average duration of infection</param>
     /// <param name="kT">average number of contacts per day</param>
-    /// <param name="kQ">days duration of quarantine</param>
+    /// <param name="kQ">days from detection until quarantine (negative to disable)</param>
     Pathogen(std::string name = "Ebola", double pE = 0.005, double pD = 0.5,
         short minE = 2, short kE = 9, short minI = 7, short kI = 9,
         short kT = 16, short kQ = 1)
-        : name(name), pcatch(pE), pdie(pD), edist(1.0f / (kE - minE + 1)),
+        : name(name), baseCatch(pE), pcatch(pE), pdie(pD), edist(1.0f / (kE - minE + 1)),
         idist(1.0f / (kI - minI + 1)), ndist(kT), minE(minE), minI(minI),
         timeQ(kQ)
     {}
 
+    /// <summary>Name of this disease.</summary>
+    /// <returns>the name given at construction</returns>
+    std::string const& getName() const { return name; }
+
+    /// <summary>Probability of transmission per contact on the current day.</summary>
+    /// <returns>the parameter <c>pE</c>, scaled by its forcing for the day set by <c>beginDay</c></returns>
+    double transmissionProbability() const { return pcatch.p(); }
+
+    /// <summary>Probability of transmission per contact per day, without forcing.</summary>
+    /// <returns>the parameter <c>pE</c></returns>
+    double baseTransmissionProbability() const { return baseCatch; }
+
+    /// <summary>Multiplier on the number of contacts for the current day.</summary>
+    /// <returns>the contact forcing for the day set by <c>beginDay</c></returns>
+    double contactScale() const { return contactFactor; }
+
+    /// <summary>
+    /// Make the transmission probability vary over time.
+    /// </summary>
+    /// <param name="f">multiplier on <c>pE</c> as a function of the day</param>
+    void setTransmissionForcing(Forcing f)
+    {
+        catchForcing = std::move(f);
+        beginDay(0);
+    }
+
+    /// <summary>
+    /// Make the contact intensity vary over time.
+    /// </summary>
+    /// <param name="f">multiplier on every host's contacts as a function of the day</param>
+    void setContactForcing(Forcing f)
+    {
+        contactForcing = std::move(f);
+        beginDay(0);
+    }
+
+    /// <summary>Multiplier on <c>pE</c> as a function of the day.</summary>
+    Forcing const& getTransmissionForcing() const { return catchForcing; }
+
+    /// <summary>Multiplier on every host's contacts as a function of the day.</summary>
+    Forcing const& getContactForcing() const { return contactForcing; }
+
+    /// <summary>
+    /// Indicates that neither transmission nor contacts vary over time.
+    /// </summary>
+    bool isUnforced() const { return catchForcing.isConstant() && contactForcing.isConstant(); }
+
+    /// <summary>
+    /// Evaluate the forcings for a day into the parameters used by the per-host methods.
+    /// </summary>
+    /// <param name="day">the simulation day about to be computed</param>
+    /// <remarks>
+    /// Called once per day by the maps; this is the only place the forcings
+    /// are evaluated, so <c>will_catch</c> and friends cost the same as without them.
+    /// </remarks>
+    void beginDay(unsigned day)
+    {
+        pcatch.param(probability(baseCatch * catchForcing(day)));
+        contactFactor = contactForcing(day);
+    }
+
+    /// <summary>Probability of death given infection.</summary>
+    /// <returns>the parameter <c>pD</c></returns>
+    double deathProbability() const { return pdie.p(); }
+
+    /// <summary>Expected number of days from exposure until infectiousness.</summary>
+    /// <returns>mean of <c>incubationPeriod()</c></returns>
+    double meanIncubation() const { return minE + (1 - edist.p()) / edist.p(); }
+
+    /// <summary>Minimum number of days from exposure until infectiousness.</summary>
+    /// <returns>the parameter <c>minE</c></returns>
+    short minIncubation() const { return minE; }
+
+    /// <summary>Minimum number of days from infectiousness until resolution.</summary>
+    /// <returns>the parameter <c>minI</c></returns>
+    short minInfection() const { return minI; }
+
+    /// <summary>Expected number of days from infectiousness until resolution.</summary>
+    /// <returns>mean of <c>infectionPeriod()</c></returns>
+    double meanInfection() const { return minI + (1 - idist.p()) / idist.p(); }
+
+    /// <summary>Expected number of close contacts per day.</summary>
+    /// <returns>the parameter <c>kT</c></returns>
+    double meanContacts() const { return ndist.mean(); }
+
     /// <summary>
     /// Indicates that an individual may contract the pathogen if exposed.
     /// </summary>
@@ -131,6 +230,20 @@ public:
     /// <returns><c>true</c> if the host died as a result of the infection, <c>false</c> otherwise</returns>
     bool isDeceased(Host const& h) const { return std::get<0>(h) == 5; }
 
+    /// <summary>
+    /// Indicates that a cell of the map holds no host at all (e.g., water or unpopulated land).
+    /// </summary>
+    /// <param name="h">a cell in the population</param>
+    /// <returns><c>true</c> if there is no host to infect, <c>false</c> otherwise</returns>
+    bool isVacant(Host const& h) const { return std::get<0>(h) == 6; }
+
+    /// <summary>
+    /// Indicates that an individual was made immune without infection (e.g., vaccinated).
+    /// </summary>
+    /// <param name="h">a potential host in the population</param>
+    /// <returns><c>true</c> if the host has been immunized, <c>false</c> otherwise</returns>
+    bool isImmune(Host const& h) const { return std::get<0>(h) == 7; }
+
     /// <summary>
     /// Indicates whether an individual is presenting symptoms.
     /// </summary>
@@ -141,6 +254,19 @@ public:
         return isInfectious(h) && std::get<1>(h) < minI;
     }
 
+    /// <summary>
+    /// Indicates whether a detected individual has been isolated from all contacts.
+    /// </summary>
+    /// <param name="h">a potential host in the population</param>
+    /// <returns><c>true</c> if the host was detected at least <c>timeQ</c> days ago, <c>false</c> otherwise</returns>
+    /// <remarks>
+    /// A negative quarantine delay disables quarantine altogether.
+    /// </remarks>
+    bool isQuarantined(Host const& h) const
+    {
+        return timeQ >= 0 && isDetected(h) && std::get<1>(h) < minI - timeQ;
+    }
+
     /// <summary>
     /// Possibly infect a susceptible host.
     /// </summary>
@@ -153,6 +279,16 @@ public:
         if (will_catch()) infect(h);
     }
 
+    /// <summary>
+    /// Possibly infect a susceptible host whose risk differs from the population baseline.
+    /// </summary>
+    /// <param name="h">a potential host in the population</param>
+    /// <param name="scale">multiplier applied to the transmission probability</param>
+    void expose(Host& h, double scale) const
+    {
+        if (will_catch(scale)) infect(h);
+    }
+
     /// <summary>
     /// Infect a host individual with this pathogen.
     /// </summary>
@@ -173,9 +309,16 @@ public:
     /// <remarks>
     /// The probability that an infection kills the host depends on properties of the pathogen.
     /// </remarks>
-    void expire(Host& h) const
+    void expire(Host& h) const { expire(h, pdie.p()); }
+
+    /// <summary>
+    /// Resolve an infection in a host with an individual mortality risk.
+    /// </summary>
+    /// <param name="h">a potential host in the population</param>
+    /// <param name="pD">probability that this host dies of the infection</param>
+    void expire(Host& h, double pD) const
     {
-        if (will_die()) {
+        if (will_die(pD)) {
             kill(h);
         }
         else {
@@ -190,12 +333,19 @@ public:
     /// <remarks>
     /// The duration of infection is determine by properties of the pathogen.
     /// </remarks>
-    void worsen(Host& h) const
+    void worsen(Host& h) const { worsen(h, pdie.p()); }
+
+    /// <summary>
+    /// Advance the infection by one day in a host with an individual mortality risk.
+    /// </summary>
+    /// <param name="h">a potential host in the population</param>
+    /// <param name="pD">probability that this host dies of the infection</param>
+    void worsen(Host& h, double pD) const
     {
         if (--std::get<1>(h) == 0) {
             ++std::get<0>(h);
             if (hasRunCourse(h)) {
-                expire(h);
+                expire(h, pD);
             }
             else {
                 std::get<1>(h) = infectionPeriod();
@@ -218,17 +368,62 @@ public:
     /// <param name="h">a potential host in the population</param>
     void kill(Host& h) const { std::get<0>(h) = 5; }
 
+    /// <summary>
+    /// Make a susceptible host immune without infection.
+    /// </summary>
+    /// <param name="h">a potential host in the population</param>
+    void immunize(Host& h) const { std::get<0>(h) = 7; }
+
+    /// <summary>
+    /// Mark a cell as holding no host.
+    /// </summary>
+    /// <param name="h">a cell in the population</param>
+    void vacate(Host& h) const { h = std::make_tuple<short, short, short>(6, 0, 0); }
+
     /// <summary>
     /// Probabilistically determine whether an individual will contract an infection.
     /// </summary>
     /// <returns><c>true</c> if the infection will take hold, <c>false</c> otherwise</returns>
-    bool will_catch() const { return pcatch(rng); }
+    bool will_catch() const { return draw(Transmission, [&](auto& g) { return pcatch(g); }); }
+
+    /// <summary>
+    /// Probabilistically determine whether an individual with scaled risk will contract an infection.
+    /// </summary>
+    /// <param name="scale">multiplier applied to the transmission probability</param>
+    /// <returns><c>true</c> if the infection will take hold, <c>false</c> otherwise</returns>
+    bool will_catch(double scale) const
+    {
+        auto p = probability(pcatch.p() * scale);
+        return draw(Transmission, [&](auto& g) { return pcatch(g, p); });
+    }
+
+    /// <summary>
+    /// Probabilistically determine whether an individual will contract an infection with a given probability.
+    /// </summary>
+    /// <param name="p">probability of infection, used in place of the transmission probability</param>
+    /// <returns><c>true</c> if the infection will take hold, <c>false</c> otherwise</returns>
+    bool will_catch_p(double p) const
+    {
+        auto q = probability(p);
+        return draw(Transmission, [&](auto& g) { return pcatch(g, q); });
+    }
 
     /// <summary>
     /// Probabilistically determine whether an individual will die from infection.
     /// </summary>
     /// <returns><c>true</c> if the infection will kill the host, <c>false</c> otherwise</returns>
-    bool will_die() const { return pdie(rng); }
+    bool will_die() const { return draw(Death, [&](auto& g) { return pdie(g); }); }
+
+    /// <summary>
+    /// Probabilistically determine whether an individual with a given risk will die from infection.
+    /// </summary>
+    /// <param name="pD">probability that this host dies of the infection</param>
+    /// <returns><c>true</c> if the infection will kill the host, <c>false</c> otherwise</returns>
+    bool will_die(double pD) const
+    {
+        auto p = probability(pD);
+        return draw(Death, [&](auto& g) { return pdie(g, p); });
+    }
 
     /// <summary>
     /// Probabilistically determine the duration of incubation.
@@ -239,7 +434,7 @@ public:
     /// so here we use the discrete analog, geometric distribution,
     /// for stochastic simulation with discrete time steps.
     /// </remarks>
-    short incubationPeriod() const { return minE + edist(rng); }
+    short incubationPeriod() const { return minE + draw(Incubation, [&](auto& g) { return edist(g); }); }
 
     /// <summary>
     /// Probabilistically determine the duration of infection.
@@ -250,21 +445,101 @@ public:
     /// so here we use the discrete analog, geometric distribution,
     /// for stochastic simulation with discrete time steps.
     /// </remarks>
-    short infectionPeriod() const { return minI + idist(rng); }
+    short infectionPeriod() const { return minI + draw(Infection, [&](auto& g) { return idist(g); }); }
 
     /// <summary>
     /// Probabilistically determine the size of the contact neighborhood for a host.
     /// </summary>
     /// <returns>distance away from this individual at which the infection can still be passed</returns>
     /// <remarks>
-    /// Here we also use a geometric distribution to model the number of close
+    /// Here we use a Poisson distribution to model the number of close
     /// contacts and individual might have in our stochastic simulation.
     /// </remarks>
-    short numNeighbors() const { return 1 + ndist(rng); }
+    short numNeighbors() const
+    {
+        auto mean = ndist.mean();
+        return static_cast<short>(1 + draw(Contacts, [&](auto& g) { return samplePoisson(g, mean); }));
+    }
+
+    /// <summary>
+    /// Switch to paired (common random numbers) mode.
+    /// </summary>
+    /// <param name="k">key identifying the replicate</param>
+    /// <remarks>
+    /// <para>
+    /// In paired mode every random decision is drawn from a counter-based
+    /// stream addressed by the key, the purpose of the decision and the host
+    /// it concerns (see <c>select</c>), instead of from the shared engine. Two
+    /// runs with the same key, e.g., a baseline and an intervention, then
+    /// make the same draw for the same host and purpose wherever their
+    /// histories agree, so their paired difference has far lower variance
+    /// than that of independent runs.
+    /// </para>
+    /// <para>
+    /// Transmission draws are keyed by infectee, infector and day; the
+    /// durations, death and contacts of a host are keyed by the host alone, so
+    /// a host infected on different days in the two runs still gets the same
+    /// course of disease.
+    /// </para>
+    /// </remarks>
+    void setKey(uint64_t k)
+    {
+        key = k;
+        keyed = true;
+    }
+
+    /// <summary>Return to independent draws from the shared engine.</summary>
+    void clearKey() { keyed = false; }
+
+    /// <summary>Indicates that this disease is in paired mode.</summary>
+    bool isKeyed() const { return keyed; }
+
+    /// <summary>
+    /// Address the streams for the decisions that follow (paired mode only).
+    /// </summary>
+    /// <param name="host">row-major index of the host the decisions concern</param>
+    /// <param name="day">the simulation day</param>
+    /// <param name="other">row-major index of the infector, for transmission</param>
+    void select(int host, unsigned day = 0, int other = -1) const
+    {
+        if (!keyed) return;
+        auto h = mixKey(key, static_cast<uint64_t>(host));
+        streams[Transmission].seek(mixKey(mixKey(h, day), static_cast<uint64_t>(static_cast<int64_t>(other) + 1)));
+        for (int p = Incubation; p < PurposeCount; ++p) streams[p].seek(mixKey(h, 0x100 + p));
+    }
+
+    /// <summary>
+    /// Seed for an auxiliary engine (e.g., seeding or vaccination), reproducible in paired mode.
+    /// </summary>
+    /// <param name="tag">distinguishes the uses of a seed within a run</param>
+    /// <returns>a seed derived from the key in paired mode, or a fresh random seed otherwise</returns>
+    uint64_t seed(uint64_t tag) const
+    {
+        if (keyed) return mixKey(mixKey(key, 0x9e3779b9ull), tag);
+        return (static_cast<uint64_t>(rng()) << 32) ^ rng();
+    }
 
 private:
+    /// <summary>
+    /// Make a draw from the stream for its purpose in paired mode, or from the shared engine.
+    /// </summary>
+    template <typename F>
+    auto draw(Purpose p, F f) const -> decltype(f(std::declval<std::default_random_engine&>()))
+    {
+        return keyed ? f(streams[p]) : f(rng);
+    }
+
+    static std::bernoulli_distribution::param_type probability(double p)
+    {
+        return std::bernoulli_distribution::param_type(p < 0 ? 0 : (p > 1 ? 1 : p));
+    }
+
     std::string name;
-    static std::default_random_engine rng;
+    double baseCatch;
+    double contactFactor = 1.0;
+    Forcing catchForcing;
+    Forcing contactForcing;
+    static thread_local std::default_random_engine rng;   // one engine per thread, so maps can run concurrently
     mutable std::bernoulli_distribution pcatch;
     mutable std::bernoulli_distribution pdie;
     mutable std::geometric_distribution<short> edist;
@@ -273,8 +548,11 @@ private:
     short minE;
     short minI;
     short timeQ;
+    bool keyed = false;
+    uint64_t key = 0;
+    mutable std::array<CounterEngine, PurposeCount> streams;
 };
 
-std::default_random_engine Pathogen::rng{ std::random_device()() };
+thread_local std::default_random_engine Pathogen::rng{ std::random_device()() };
 
 #endif /*HPP_PATHOGEN*/
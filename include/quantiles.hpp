@@ -0,0 +1,262 @@
+#ifndef HPP_QUANTILES
+#define HPP_QUANTILES
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "ensemble.hpp"
+
+/// <summary>
+/// Mergeable streaming quantile sketch (t-digest).
+/// </summary>
+/// <remarks>
+/// <para>
+/// Values are summarized by at most about <c>2 * compression</c> weighted
+/// centroids, which are small near the tails and large near the median, so
+/// extreme quantiles stay accurate. New values are buffered and merged in
+/// sorted batches; two digests merge by pooling their centroids.
+/// </para>
+/// <para>
+/// Reference: Dunning and Ertl, "Computing extremely accurate quantiles
+/// using t-digests" (2019).
+/// </para>
+/// </remarks>
+class TDigest
+{
+public:
+    /// <summary>
+    /// Initialize an empty sketch.
+    /// </summary>
+    /// <param name="compression">accuracy parameter; larger keeps more centroids</param>
+    explicit TDigest(double compression = 100.0) : delta(compression) {}
+
+    /// <summary>
+    /// Add a value.
+    /// </summary>
+    /// <param name="x">the value</param>
+    /// <param name="w">its weight</param>
+    void add(double x, double w = 1.0)
+    {
+        buffer.emplace_back(x, w);
+        lo = std::min(lo, x);
+        hi = std::max(hi, x);
+        if (buffer.size() >= 8 * static_cast<size_t>(delta)) compress();
+    }
+
+    /// <summary>
+    /// Add every value summarized by another sketch.
+    /// </summary>
+    /// <param name="other">a sketch</param>
+    void merge(TDigest const& other)
+    {
+        buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+        buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+        lo = std::min(lo, other.lo);
+        hi = std::max(hi, other.hi);
+        compress();
+    }
+
+    /// <summary>Total weight of the values added.</summary>
+    double count() const
+    {
+        double n = 0;
+        for (auto const& c : centroids) n += c.second;
+        for (auto const& c : buffer) n += c.second;
+        return n;
+    }
+
+    /// <summary>
+    /// Estimate a quantile.
+    /// </summary>
+    /// <param name="q">probability in [0,1]</param>
+    /// <returns>the estimated value, or NaN if the sketch is empty</returns>
+    double quantile(double q)
+    {
+        compress();
+        if (centroids.empty()) return std::numeric_limits<double>::quiet_NaN();
+        if (centroids.size() == 1) return centroids[0].first;
+        q = std::min(std::max(q, 0.0), 1.0);
+        auto target = q * total;
+
+        // Each centroid's mass is centered on its mean; interpolate between centers.
+        double cum = 0;
+        auto prevMean = lo, prevMid = 0.0;
+        for (auto const& c : centroids) {
+            auto mid = cum + c.second / 2;
+            if (target < mid) {
+                if (mid == prevMid) return c.first;
+                return prevMean + (c.first - prevMean) * (target - prevMid) / (mid - prevMid);
+            }
+            prevMean = c.first;
+            prevMid = mid;
+            cum += c.second;
+        }
+        if (total == prevMid) return hi;
+        return prevMean + (hi - prevMean) * (target - prevMid) / (total - prevMid);
+    }
+
+private:
+    using Centroid = std::pair<double, double>;     // mean, weight
+
+    /// <summary>
+    /// Merge buffered values into the centroids, respecting the size bound.
+    /// </summary>
+    void compress()
+    {
+        if (buffer.empty()) return;
+        buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+        std::sort(buffer.begin(), buffer.end());
+        total = 0;
+        for (auto const& c : buffer) total += c.second;
+
+        centroids.clear();
+        auto cur = buffer[0];
+        double cum = 0;
+        for (size_t k = 1; k < buffer.size(); ++k) {
+            auto const& x = buffer[k];
+            auto w = cur.second + x.second;
+            auto q = (cum + w / 2) / total;
+            if (w <= std::max(1.0, 4 * total * q * (1 - q) / delta)) {
+                cur.first += (x.first - cur.first) * x.second / w;
+                cur.second = w;
+            }
+            else {
+                cum += cur.second;
+                centroids.push_back(cur);
+                cur = x;
+            }
+        }
+        centroids.push_back(cur);
+        buffer.clear();
+    }
+
+    double delta;
+    double total = 0;
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    std::vector<Centroid> centroids;
+    std::vector<Centroid> buffer;
+};
+
+/// <summary>
+/// Quantile bands of daily counts across an ensemble, for fan charts.
+/// </summary>
+/// <remarks>
+/// Every worker records the daily counts of its current replicate and
+/// then adds them to its own t-digest for each day and series; the digests
+/// of all workers are merged at the end. Memory is bounded by the number of
+/// days and the compression, independent of the number of replicates.
+/// A replicate that dies out early keeps its final counts for the rest of
+/// the horizon. Counts are taken at the end of each day, so day <c>d</c>
+/// (from 1 to the horizon) is the state after <c>d</c> days, as reported by
+/// <c>HostMap::getDay</c>.
+/// </remarks>
+class TrajectoryBands : public EnsembleCollector
+{
+public:
+    /// <summary>Daily counts that are summarized.</summary>
+    enum Series { Exposed, Infectious, Recovered, Deceased, Cumulative, SeriesCount };
+
+    /// <summary>
+    /// Initialize the bands for an ensemble.
+    /// </summary>
+    /// <param name="horizon">number of days per replicate (see <c>Ensemble::days</c>)</param>
+    /// <param name="compression">accuracy parameter of each digest</param>
+    explicit TrajectoryBands(unsigned horizon, double compression = 100.0)
+        : horizon(horizon), compression(compression)
+    {}
+
+    void prepare(unsigned workers, size_t, size_t) override
+    {
+        result.assign(horizon * SeriesCount, TDigest(compression));
+        shards.clear();
+        for (unsigned w = 0; w < workers; ++w) shards.emplace_back(new Shard(horizon, compression));
+    }
+
+    InfectionObserver* observer(unsigned worker) override { return shards[worker].get(); }
+
+    void replicateDone(HostMap const& map, unsigned, unsigned worker) override
+    {
+        auto& s = *shards[worker];
+        auto last = counts(map);
+        for (unsigned d = 0; d < horizon; ++d) {
+            auto const& v = d < s.trajectory.size() ? s.trajectory[d] : last;
+            for (int k = 0; k < SeriesCount; ++k) s.digests[d * SeriesCount + k].add(v[k]);
+        }
+        s.trajectory.clear();
+    }
+
+    void finish() override
+    {
+        parallelFor(0, result.size(), [&](size_t lo, size_t hi, unsigned) {
+            for (auto k = lo; k < hi; ++k) {
+                for (auto const& s : shards) result[k].merge(s->digests[k]);
+            }
+        });
+        shards.clear();
+    }
+
+    /// <summary>
+    /// Estimate a quantile of a daily count across replicates.
+    /// </summary>
+    /// <param name="day">number of days simulated, from 1 to the horizon</param>
+    /// <param name="series">which count</param>
+    /// <param name="q">probability in [0,1]</param>
+    double quantile(unsigned day, Series series, double q) { return result[(day - 1) * SeriesCount + series].quantile(q); }
+
+    /// <summary>
+    /// Write one line per day with the given quantiles of a count, separated by commas.
+    /// </summary>
+    /// <param name="os">output stream</param>
+    /// <param name="series">which count</param>
+    /// <param name="qs">probabilities, e.g., { 0.025, 0.5, 0.975 }</param>
+    void writeCsv(std::ostream& os, Series series, std::vector<double> const& qs)
+    {
+        os << "day";
+        for (auto q : qs) os << ",q" << q;
+        os << '\n';
+        for (unsigned d = 1; d <= horizon; ++d) {
+            os << d;
+            for (auto q : qs) os << ',' << quantile(d, series, q);
+            os << '\n';
+        }
+    }
+
+private:
+    using Counts = std::array<double, SeriesCount>;
+
+    static Counts counts(HostMap const& map)
+    {
+        return { {
+            static_cast<double>(map.countExposed()), static_cast<double>(map.countInfectious()),
+            static_cast<double>(map.countRecovered()), static_cast<double>(map.countDeceased()),
+            static_cast<double>(map.countCumulative())
+        } };
+    }
+
+    /// <summary>
+    /// Daily counts of one worker's current replicate, and that worker's digests.
+    /// </summary>
+    struct Shard : InfectionObserver
+    {
+        Shard(unsigned horizon, double compression) : digests(horizon * SeriesCount, TDigest(compression)) {}
+
+        void onInfection(unsigned, int, int) override {}
+        void onDayEnd(HostMap const& map) override { trajectory.push_back(counts(map)); }
+        void onReset() override { trajectory.clear(); }
+
+        std::vector<Counts> trajectory;
+        std::vector<TDigest> digests;
+    };
+
+    unsigned horizon;
+    double compression;
+    std::vector<TDigest> result;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+#endif /*HPP_QUANTILES*/
@@ -0,0 +1,312 @@
+#ifndef HPP_RASTER
+#define HPP_RASTER
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+/// <summary>
+/// Read-only view of an entire file mapped into memory.
+/// </summary>
+class MappedFile
+{
+public:
+    /// <summary>
+    /// Map a file into memory.
+    /// </summary>
+    /// <param name="path">location of the file to map</param>
+    explicit MappedFile(std::string const& path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) fail(path);
+        LARGE_INTEGER n;
+        if (!GetFileSizeEx(file, &n)) fail(path);
+        length = static_cast<size_t>(n.QuadPart);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) fail(path);
+        base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!base) fail(path);
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) fail(path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) fail(path);
+        length = static_cast<size_t>(st.st_size);
+        base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            fail(path);
+        }
+#endif
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    ~MappedFile() { release(); }
+
+    /// <summary>Start of the mapped bytes.</summary>
+    /// <returns>pointer to the first byte of the file</returns>
+    unsigned char const* data() const { return static_cast<unsigned char const*>(base); }
+
+    /// <summary>Length of the mapped file.</summary>
+    /// <returns>number of bytes in the file</returns>
+    size_t size() const { return length; }
+
+private:
+    void release()
+    {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (base) munmap(const_cast<void*>(base), length);
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    [[noreturn]] void fail(std::string const& path)
+    {
+        release();
+        throw std::runtime_error("MappedFile: unable to map " + path);
+    }
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    void const* base = nullptr;
+    size_t length = 0;
+};
+
+/// <summary>
+/// Grid-aligned layer of 8- or 16-bit quantized values backed by a memory-mapped file.
+/// </summary>
+/// <remarks>
+/// <para>
+/// File layout (little-endian): the magic bytes <c>GMRS</c>, then
+/// <c>uint32</c> rows, <c>uint32</c> columns, <c>uint32</c> bits per value
+/// (8 or 16), <c>float</c> scale, <c>float</c> offset, followed by
+/// rows*columns quantized values in row-major order.
+/// </para>
+/// <para>
+/// The real value of a cell is <c>offset + scale * q</c>, where <c>q</c> is
+/// the stored integer. Only the pages touched by the simulation are read from
+/// disk, so sparse or partially simulated maps stay cheap.
+/// </para>
+/// </remarks>
+class QuantizedRaster
+{
+public:
+    /// <summary>Size in Bytes of the header preceding the values.</summary>
+    static constexpr size_t header_size = 24;
+
+    /// <summary>
+    /// Map a quantized raster file.
+    /// </summary>
+    /// <param name="path">location of the raster file</param>
+    explicit QuantizedRaster(std::string const& path)
+        : file(new MappedFile(path))
+    {
+        auto p = file->data();
+        if (file->size() < header_size || std::memcmp(p, "GMRS", 4) != 0) {
+            throw std::runtime_error("QuantizedRaster: " + path + " is not a raster file");
+        }
+        uint32_t r, c, b;
+        std::memcpy(&r, p + 4, 4);
+        std::memcpy(&c, p + 8, 4);
+        std::memcpy(&b, p + 12, 4);
+        std::memcpy(&scale, p + 16, 4);
+        std::memcpy(&offset, p + 20, 4);
+        rows = r;
+        cols = c;
+        bits = b;
+        if ((bits != 8 && bits != 16)
+            || file->size() < header_size + rows * cols * (bits / 8)) {
+            throw std::runtime_error("QuantizedRaster: " + path + " is truncated or malformed");
+        }
+        values = p + header_size;
+    }
+
+    /// <summary>Height of the raster.</summary>
+    /// <returns>number of rows in the layer</returns>
+    size_t row_count() const { return rows; }
+
+    /// <summary>Width of the raster.</summary>
+    /// <returns>number of columns in the layer</returns>
+    size_t col_count() const { return cols; }
+
+    /// <summary>
+    /// Stored (quantized) value of a cell.
+    /// </summary>
+    /// <param name="k">row-major index of a cell</param>
+    /// <returns>the raw integer value</returns>
+    unsigned quantized(size_t k) const
+    {
+        return bits == 8 ? values[k] : reinterpret_cast<uint16_t const*>(values)[k];
+    }
+
+    /// <summary>
+    /// Real value of a cell.
+    /// </summary>
+    /// <param name="k">row-major index of a cell</param>
+    /// <returns><c>offset + scale * q</c></returns>
+    float at(size_t k) const { return offset + scale * static_cast<float>(quantized(k)); }
+
+    /// <summary>
+    /// Real value of a cell.
+    /// </summary>
+    /// <param name="i">row index</param>
+    /// <param name="j">column index</param>
+    /// <returns><c>offset + scale * q</c></returns>
+    float operator()(size_t i, size_t j) const { return at(i * cols + j); }
+
+    /// <summary>
+    /// Quantize real values and write them as a raster file.
+    /// </summary>
+    /// <param name="path">location of the raster file to create</param>
+    /// <param name="r">number of rows</param>
+    /// <param name="c">number of columns</param>
+    /// <param name="data">r*c real values in row-major order</param>
+    /// <param name="b">bits per stored value (8 or 16)</param>
+    /// <remarks>
+    /// The scale and offset are chosen to span the range of the values, so
+    /// the rounding error is at most half a quantization step.
+    /// </remarks>
+    static void write(std::string const& path, size_t r, size_t c, float const* data, unsigned b = 16)
+    {
+        if (b != 8 && b != 16) throw std::invalid_argument("QuantizedRaster: bits must be 8 or 16");
+        auto n = r * c;
+        auto lo = n ? *std::min_element(data, data + n) : 0.0f;
+        auto hi = n ? *std::max_element(data, data + n) : 0.0f;
+        auto top = static_cast<float>((1u << b) - 1);
+        float off = lo, sc = hi > lo ? (hi - lo) / top : 1.0f;
+
+        std::vector<unsigned char> buf(header_size + n * (b / 8));
+        auto r32 = static_cast<uint32_t>(r), c32 = static_cast<uint32_t>(c), b32 = static_cast<uint32_t>(b);
+        std::memcpy(buf.data(), "GMRS", 4);
+        std::memcpy(buf.data() + 4, &r32, 4);
+        std::memcpy(buf.data() + 8, &c32, 4);
+        std::memcpy(buf.data() + 12, &b32, 4);
+        std::memcpy(buf.data() + 16, &sc, 4);
+        std::memcpy(buf.data() + 20, &off, 4);
+        auto out = buf.data() + header_size;
+        for (size_t k = 0; k < n; ++k) {
+            auto q = static_cast<uint16_t>(std::lround(std::min(std::max((data[k] - off) / sc, 0.0f), top)));
+            if (b == 8)
+                out[k] = static_cast<unsigned char>(q);
+            else
+                std::memcpy(out + 2 * k, &q, 2);
+        }
+        std::ofstream os(path, std::ios::binary);
+        if (!os.write(reinterpret_cast<char const*>(buf.data()), buf.size())) {
+            throw std::runtime_error("QuantizedRaster: unable to write " + path);
+        }
+    }
+
+private:
+    std::unique_ptr<MappedFile> file;
+    unsigned char const* values = nullptr;
+    size_t rows = 0;
+    size_t cols = 0;
+    unsigned bits = 0;
+    float scale = 1.0f;
+    float offset = 0.0f;
+};
+
+/// <summary>
+/// Spatially varying model parameters, given as raster layers aligned with the host grid.
+/// </summary>
+/// <remarks>
+/// Every layer is optional:
+/// - transmission: multiplier on <c>pE</c> for a susceptible host in each cell
+/// - contact: multiplier on the number of close contacts of a host in each cell
+/// - density: probability that a cell holds a host; cells with density 0
+///   (e.g., water, unpopulated land) are no-host cells that the step skips
+/// </remarks>
+class SpatialParameters
+{
+public:
+    /// <summary>
+    /// Map the given raster files; an empty path leaves that layer unset.
+    /// </summary>
+    /// <param name="transmissionPath">raster of transmission multipliers</param>
+    /// <param name="contactPath">raster of contact intensity multipliers</param>
+    /// <param name="densityPath">raster of population densities in [0,1]</param>
+    SpatialParameters(std::string const& transmissionPath = "",
+        std::string const& contactPath = "", std::string const& densityPath = "")
+        : transmission(load(transmissionPath)), contact(load(contactPath)),
+        density(load(densityPath))
+    {}
+
+    /// <summary>Determine whether all present layers match a grid's dimensions.</summary>
+    /// <param name="r">number of rows in the grid</param>
+    /// <param name="c">number of columns in the grid</param>
+    /// <returns><c>true</c> if every layer is <c>r</c> by <c>c</c></returns>
+    bool fits(size_t r, size_t c) const
+    {
+        return fits(transmission.get(), r, c) && fits(contact.get(), r, c) && fits(density.get(), r, c);
+    }
+
+    /// <summary>Whether a transmission layer is present.</summary>
+    bool hasTransmission() const { return static_cast<bool>(transmission); }
+
+    /// <summary>Whether a density layer is present.</summary>
+    bool hasDensity() const { return static_cast<bool>(density); }
+
+    /// <summary>Transmission multiplier of a cell (1 if the layer is absent).</summary>
+    /// <param name="k">row-major index of a cell</param>
+    float transmissionScale(size_t k) const { return transmission ? transmission->at(k) : 1.0f; }
+
+    /// <summary>Contact intensity multiplier of a cell (1 if the layer is absent).</summary>
+    /// <param name="k">row-major index of a cell</param>
+    float contactScale(size_t k) const { return contact ? contact->at(k) : 1.0f; }
+
+    /// <summary>Population density of a cell (1 if the layer is absent).</summary>
+    /// <param name="k">row-major index of a cell</param>
+    float populationDensity(size_t k) const { return density ? density->at(k) : 1.0f; }
+
+private:
+    static std::unique_ptr<QuantizedRaster> load(std::string const& path)
+    {
+        return std::unique_ptr<QuantizedRaster>(path.empty() ? nullptr : new QuantizedRaster(path));
+    }
+
+    static bool fits(QuantizedRaster const* layer, size_t r, size_t c)
+    {
+        return !layer || (layer->row_count() == r && layer->col_count() == c);
+    }
+
+    std::unique_ptr<QuantizedRaster> transmission;
+    std::unique_ptr<QuantizedRaster> contact;
+    std::unique_ptr<QuantizedRaster> density;
+};
+
+#endif /*HPP_RASTER*/
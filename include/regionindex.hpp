@@ -0,0 +1,192 @@
+#ifndef HPP_REGIONINDEX
+#define HPP_REGIONINDEX
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "hostmap.hpp"
+#include "parallel.hpp"
+
+/// <summary>
+/// Host counts by state within a rectangular region.
+/// </summary>
+struct RegionCounts
+{
+    uint32_t susceptible = 0;
+    uint32_t exposed = 0;
+    uint32_t infectious = 0;
+    uint32_t recovered = 0;
+    uint32_t deceased = 0;
+    uint32_t immune = 0;
+};
+
+/// <summary>
+/// Index answering per-state host counts over any rectangle in O(log^2 N).
+/// </summary>
+/// <remarks>
+/// <para>
+/// One 2D Fenwick (binary indexed) tree of 32-bit counts is kept per
+/// state, and updated from the map's notifications as hosts change state,
+/// so each infection or transition costs O(log^2 N). Bulk changes (reset,
+/// vaccination) are found by comparing the region against a one-byte copy
+/// of each host's state. The transient "resolved" state and vacant cells
+/// are not indexed.
+/// </para>
+/// <para>
+/// Memory is 25 bytes per cell, so on very large grids the index is best
+/// attached only while it is being queried.
+/// </para>
+/// </remarks>
+class RegionIndex : public InfectionObserver
+{
+public:
+    /// <summary>
+    /// Build the index for the current state of a map.
+    /// </summary>
+    /// <param name="map">the map to be observed</param>
+    RegionIndex(HostMap const& map)
+        : rows(static_cast<int>(map.row_count())), cols(static_cast<int>(map.col_count())),
+        state(static_cast<size_t>(rows) * cols, uint8_t(none))
+    {
+        for (auto& t : trees) t.assign(state.size(), 0);
+        onRegionChanged(map, map.bounds());
+    }
+
+    void onInfection(unsigned, int, int infectee) override { change(infectee, 1); }
+
+    void onTransition(int k, int, int to) override { change(k, to); }
+
+    void onRegionChanged(HostMap const& map, Region region) override
+    {
+        if (region.row == 0 && region.col == 0 && region.rows == rows && region.cols == cols) {
+            rebuild(map);
+            return;
+        }
+        for (auto i = region.row; i < region.row + region.rows; ++i) {
+            auto const& row = map[i];
+            for (auto j = region.col; j < region.col + region.cols; ++j) {
+                change(i * cols + j, std::get<0>(row[j]));
+            }
+        }
+    }
+
+    /// <summary>
+    /// Count the hosts in a given state within a region.
+    /// </summary>
+    /// <param name="s">state code (see <c>Host</c>)</param>
+    /// <param name="region">block of cells, clipped to the grid</param>
+    /// <returns>the number of hosts in state <c>s</c></returns>
+    uint32_t count(int s, Region region) const
+    {
+        auto t = slot(s);
+        if (t == none) return 0;
+        auto r0 = std::max(region.row, 0), r1 = std::min(region.row + region.rows, rows);
+        auto c0 = std::max(region.col, 0), c1 = std::min(region.col + region.cols, cols);
+        if (r0 >= r1 || c0 >= c1) return 0;
+        auto const& f = trees[t];
+        return prefix(f, r1, c1) - prefix(f, r0, c1) - prefix(f, r1, c0) + prefix(f, r0, c0);
+    }
+
+    /// <summary>
+    /// Count the hosts in every state within a region.
+    /// </summary>
+    /// <param name="region">block of cells, clipped to the grid</param>
+    RegionCounts counts(Region region) const
+    {
+        RegionCounts c;
+        c.susceptible = count(0, region);
+        c.exposed = count(1, region);
+        c.infectious = count(2, region);
+        c.recovered = count(4, region);
+        c.deceased = count(5, region);
+        c.immune = count(7, region);
+        return c;
+    }
+
+private:
+    static constexpr uint8_t none = 0xff;
+
+    /// <summary>Tree holding a state code, or <c>none</c> if it is not indexed.</summary>
+    static uint8_t slot(int s)
+    {
+        static const uint8_t slots[8] = { 0, 1, 2, 0xff, 3, 4, 0xff, 5 };
+        return (s >= 0 && s < 8) ? slots[s] : uint8_t(none);
+    }
+
+    /// <summary>
+    /// Record that the host at index k is now in state s.
+    /// </summary>
+    void change(int k, int s)
+    {
+        auto to = slot(s);
+        auto from = state[k];
+        if (from == to) return;
+        auto i = k / cols, j = k % cols;
+        if (from != none) add(trees[from], i, j, -1);
+        if (to != none) add(trees[to], i, j, 1);
+        state[k] = to;
+    }
+
+    void add(std::vector<uint32_t>& f, int i, int j, int delta)
+    {
+        for (auto x = i + 1; x <= rows; x += x & -x) {
+            auto base = static_cast<size_t>(x - 1) * cols - 1;
+            for (auto y = j + 1; y <= cols; y += y & -y) f[base + y] += delta;
+        }
+    }
+
+    /// <summary>Sum over rows [0,i) and columns [0,j).</summary>
+    uint32_t prefix(std::vector<uint32_t> const& f, int i, int j) const
+    {
+        uint32_t sum = 0;
+        for (auto x = i; x > 0; x -= x & -x) {
+            auto base = static_cast<size_t>(x - 1) * cols - 1;
+            for (auto y = j; y > 0; y -= y & -y) sum += f[base + y];
+        }
+        return sum;
+    }
+
+    /// <summary>
+    /// Rebuild every tree from scratch in linear time.
+    /// </summary>
+    void rebuild(HostMap const& map)
+    {
+        for (auto& t : trees) std::fill(t.begin(), t.end(), 0);
+        parallelFor(0, rows, [&](size_t lo, size_t hi, unsigned) {
+            for (auto i = lo; i < hi; ++i) {
+                auto const& row = map[i];
+                auto base = i * cols;
+                for (int j = 0; j < cols; ++j) {
+                    auto s = slot(std::get<0>(row[j]));
+                    state[base + j] = s;
+                    if (s != none) trees[s][base + j] = 1;
+                }
+                // Fenwick build along the row: push each node into its parent.
+                for (auto& f : trees) {
+                    for (int y = 1; y <= cols; ++y) {
+                        auto parent = y + (y & -y);
+                        if (parent <= cols) f[base + parent - 1] += f[base + y - 1];
+                    }
+                }
+            }
+        });
+        // Then along the columns, a whole row at a time.
+        for (auto& f : trees) {
+            for (int x = 1; x <= rows; ++x) {
+                auto parent = x + (x & -x);
+                if (parent > rows) continue;
+                auto src = &f[static_cast<size_t>(x - 1) * cols];
+                auto dst = &f[static_cast<size_t>(parent - 1) * cols];
+                for (int y = 0; y < cols; ++y) dst[y] += src[y];
+            }
+        }
+    }
+
+    int rows;
+    int cols;
+    std::vector<uint8_t> state;
+    std::array<std::vector<uint32_t>, 6> trees;
+};
+
+#endif /*HPP_REGIONINDEX*/
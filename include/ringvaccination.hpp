@@ -0,0 +1,116 @@
+#ifndef HPP_RINGVACCINATION
+#define HPP_RINGVACCINATION
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "hostmap.hpp"
+
+/// <summary>
+/// Ring vaccination policy: immunize susceptible hosts within a radius of each newly detected case.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Each ring is a disk of the given radius on the torus, decomposed into one
+/// column interval per row. The intervals from all of the day's detections
+/// are sorted and merged, so overlapping rings are vaccinated only once, and
+/// the resulting disjoint spans are immunized in parallel.
+/// </para>
+/// <para>
+/// The work per day is proportional to the number of detections times the
+/// ring diameter (plus the hosts inside the rings), independent of the grid area.
+/// </para>
+/// </remarks>
+class RingVaccination
+{
+public:
+    /// <summary>
+    /// Initialize the policy.
+    /// </summary>
+    /// <param name="radius">distance (in cells) around each detected case to vaccinate</param>
+    /// <param name="coverage">probability that each susceptible host in a ring is immunized</param>
+    RingVaccination(int radius, double coverage = 1.0)
+        : radius(radius), coverage(coverage)
+    {}
+
+    /// <summary>
+    /// Vaccinate around the cases detected during the map's most recent day.
+    /// </summary>
+    /// <param name="map">the simulated population</param>
+    /// <returns>number of hosts immunized</returns>
+    int apply(HostMap& map)
+    {
+        auto& cases = map.newlyDetected();
+        if (cases.empty()) return 0;
+
+        auto N = static_cast<int>(map.row_count());
+        auto M = static_cast<int>(map.col_count());
+        auto r = std::min(radius, std::max(N, M));
+
+        spans.clear();
+        for (auto k : cases) {
+            auto ci = k / M, cj = k % M;
+            for (auto dy = -r; dy <= r; ++dy) {
+                auto half = static_cast<int>(std::sqrt(static_cast<double>(r * r - dy * dy)));
+                auto i = ((ci + dy) % N + N) % N;
+                addSpan(i, cj - half, cj + half, M);
+            }
+        }
+
+        std::sort(spans.begin(), spans.end(), [](Region const& a, Region const& b) {
+            return a.row < b.row || (a.row == b.row && a.col < b.col);
+        });
+        merged.clear();
+        for (auto& s : spans) {
+            if (!merged.empty() && merged.back().row == s.row
+                && s.col <= merged.back().col + merged.back().cols) {
+                auto end = std::max(merged.back().col + merged.back().cols, s.col + s.cols);
+                merged.back().cols = end - merged.back().col;
+            }
+            else {
+                merged.push_back(s);
+            }
+        }
+        return map.vaccinate(merged, coverage);
+    }
+
+    /// <summary>
+    /// Advance the simulation one day and then vaccinate around the new detections.
+    /// </summary>
+    /// <param name="map">the simulated population</param>
+    /// <returns>number of hosts immunized</returns>
+    int advance(HostMap& map)
+    {
+        map.computeNext();
+        return apply(map);
+    }
+
+private:
+    /// <summary>
+    /// Record the columns [lo, hi] of row i, splitting intervals that wrap around the torus.
+    /// </summary>
+    void addSpan(int i, int lo, int hi, int M)
+    {
+        if (hi - lo + 1 >= M) {
+            spans.push_back({ i, 0, 1, M });
+        }
+        else if (lo < 0) {
+            spans.push_back({ i, 0, 1, hi + 1 });
+            spans.push_back({ i, M + lo, 1, -lo });
+        }
+        else if (hi >= M) {
+            spans.push_back({ i, lo, 1, M - lo });
+            spans.push_back({ i, 0, 1, hi - M + 1 });
+        }
+        else {
+            spans.push_back({ i, lo, 1, hi - lo + 1 });
+        }
+    }
+
+    int radius;
+    double coverage;
+    std::vector<Region> spans;
+    std::vector<Region> merged;
+};
+
+#endif /*HPP_RINGVACCINATION*/
@@ -0,0 +1,218 @@
+#ifndef HPP_SAMPLING
+#define HPP_SAMPLING
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+/*
+    Fast discrete samplers for count-based engines.
+
+    The standard library distributions are exact but keep per-parameter
+    state, so drawing with a different (n, p) or mean each time means
+    constructing a new distribution object for every draw. These functions
+    take their parameters per call and choose the algorithm by regime:
+
+    - binomial: inversion (BINV) when n*min(p,1-p) is small, otherwise the
+      transformed rejection method BTRS of Hoermann (1993)
+    - Poisson: inversion when the mean is small, otherwise PTRS (Hoermann 1993)
+    - batches of Poisson draws with individual means: inversion in lock step
+      across lanes, in branch-free loops that compilers vectorize
+
+    Both rejection methods accept about 85-90% of proposals and need only a
+    log-factorial evaluation on the rare slow path. That comes from a table
+    and a Stirling series rather than std::lgamma, which writes the global
+    signgam and so is not safe to call from several threads at once.
+*/
+
+/// <summary>
+/// Natural logarithm of the factorial of a non-negative integer.
+/// </summary>
+/// <param name="k">a non-negative integer value</param>
+/// <returns><c>log(k!)</c></returns>
+/// <remarks>
+/// Exact sums below 256, then the Stirling series for <c>log Gamma(k + 1)</c>,
+/// whose truncation error is below 1e-19 there. Safe to call concurrently.
+/// </remarks>
+inline double logFactorial(double k)
+{
+    constexpr int size = 256;
+    static auto const table = [] {
+        std::array<double, size> t;
+        t[0] = 0.0;
+        for (int i = 1; i < size; ++i) t[i] = t[i - 1] + std::log(static_cast<double>(i));
+        return t;
+    }();
+    if (k < size) return table[static_cast<int>(k)];
+    auto x = k + 1;
+    auto r = 1 / (x * x);
+    return (x - 0.5) * std::log(x) - x + 0.91893853320467274178
+        + (1.0 / 12 - r * (1.0 / 360 - r * (1.0 / 1260))) / x;
+}
+
+/// <summary>
+/// Draw a uniform variate from the open interval (0,1).
+/// </summary>
+/// <param name="gen">a random number engine</param>
+/// <returns>a double-precision value strictly between 0 and 1</returns>
+template <typename Engine>
+inline double sampleUniform(Engine& gen)
+{
+    double u;
+    do {
+        u = std::generate_canonical<double, 32>(gen);
+    } while (u <= 0.0);
+    return u;
+}
+
+/// <summary>
+/// Draw from a binomial distribution.
+/// </summary>
+/// <param name="gen">a random number engine</param>
+/// <param name="n">number of trials</param>
+/// <param name="p">probability of success in each trial</param>
+/// <returns>number of successes in <c>[0, n]</c></returns>
+template <typename Engine>
+uint32_t sampleBinomial(Engine& gen, uint32_t n, double p)
+{
+    if (n == 0 || p <= 0) return 0;
+    if (p >= 1) return n;
+    if (p > 0.5) return n - sampleBinomial(gen, n, 1 - p);
+
+    auto q = 1 - p;
+    if (n * p < 14) {
+        // BINV: sequential search of the CDF, starting from P(X = 0) = q^n.
+        auto s = p / q;
+        auto a = (n + 1) * s;
+        auto r0 = std::exp(n * std::log1p(-p));
+        for (;;) {
+            auto u = sampleUniform(gen);
+            auto r = r0;
+            uint32_t x = 0;
+            while (u > r) {
+                u -= r;
+                if (++x > n) break;
+                r *= a / x - s;
+            }
+            if (x <= n) return x;
+        }
+    }
+
+    // BTRS: transformed rejection with squeeze.
+    auto spq = std::sqrt(n * p * q);
+    auto b = 1.15 + 2.53 * spq;
+    auto a = -0.0873 + 0.0248 * b + 0.01 * p;
+    auto c = n * p + 0.5;
+    auto vr = 0.92 - 4.2 / b;
+    auto alpha = (2.83 + 5.1 / b) * spq;
+    auto lpq = std::log(p / q);
+    auto m = std::floor((n + 1) * p);
+    auto h = logFactorial(m) + logFactorial(n - m);
+    for (;;) {
+        auto u = sampleUniform(gen) - 0.5;
+        auto v = sampleUniform(gen);
+        auto us = 0.5 - std::fabs(u);
+        auto k = std::floor((2 * a / us + b) * u + c);
+        if (k < 0 || k > n) continue;
+        if (us >= 0.07 && v <= vr) return static_cast<uint32_t>(k);
+        v = std::log(v * alpha / (a / (us * us) + b));
+        if (v <= h - logFactorial(k) - logFactorial(n - k) + (k - m) * lpq) {
+            return static_cast<uint32_t>(k);
+        }
+    }
+}
+
+/// <summary>
+/// Draw from a Poisson distribution.
+/// </summary>
+/// <param name="gen">a random number engine</param>
+/// <param name="mu">mean of the distribution</param>
+/// <returns>a non-negative count</returns>
+template <typename Engine>
+uint32_t samplePoisson(Engine& gen, double mu)
+{
+    if (mu <= 0) return 0;
+    if (mu < 10) {
+        auto p = std::exp(-mu);
+        auto f = p;
+        auto u = sampleUniform(gen);
+        uint32_t x = 0;
+        while (u > f && p > 0) {
+            p *= mu / ++x;
+            f += p;
+        }
+        return x;
+    }
+
+    // PTRS: transformed rejection with squeeze.
+    auto slam = std::sqrt(mu);
+    auto loglam = std::log(mu);
+    auto b = 0.931 + 2.53 * slam;
+    auto a = -0.059 + 0.02483 * b;
+    auto invalpha = 1.1239 + 1.1328 / (b - 3.4);
+    auto vr = 0.9277 - 3.6224 / (b - 2);
+    for (;;) {
+        auto u = sampleUniform(gen) - 0.5;
+        auto v = sampleUniform(gen);
+        auto us = 0.5 - std::fabs(u);
+        auto k = std::floor((2 * a / us + b) * u + mu + 0.43);
+        if (us >= 0.07 && v <= vr) return static_cast<uint32_t>(k);
+        if (k < 0 || (us < 0.013 && v > us)) continue;
+        if (std::log(v) + std::log(invalpha) - std::log(a / (us * us) + b)
+            <= -mu + k * loglam - logFactorial(k)) {
+            return static_cast<uint32_t>(k);
+        }
+    }
+}
+
+/// <summary>
+/// Draw a batch of Poisson variates with individual means.
+/// </summary>
+/// <param name="gen">a random number engine</param>
+/// <param name="mu">array of <c>count</c> means</param>
+/// <param name="out">array receiving <c>count</c> draws</param>
+/// <param name="count">number of draws</param>
+/// <remarks>
+/// Means below 10 are handled by inversion in lock step across a block of
+/// lanes: every iteration of the search updates all lanes with the same
+/// branch-free arithmetic, which compilers vectorize. Larger means fall
+/// back to <c>samplePoisson</c>.
+/// </remarks>
+template <typename Engine>
+void samplePoissonBatch(Engine& gen, float const* mu, uint32_t* out, size_t count)
+{
+    constexpr size_t lanes = 64;
+    double u[lanes], p[lanes], f[lanes], m[lanes];
+    for (size_t base = 0; base < count; base += lanes) {
+        auto width = count - base < lanes ? count - base : lanes;
+        double top = 0.0;
+        for (size_t l = 0; l < width; ++l) {
+            double x = mu[base + l];
+            m[l] = (x > 0.0 && x < 10.0) ? x : 0.0;
+            u[l] = sampleUniform(gen);
+            top = m[l] > top ? m[l] : top;
+        }
+        for (size_t l = 0; l < width; ++l) {
+            p[l] = std::exp(-m[l]);
+            f[l] = p[l];
+            out[base + l] = 0;
+        }
+        // P(X > 2*mu + 24) is below 1e-12 for every mean under 10.
+        auto limit = static_cast<uint32_t>(top * 2 + 24);
+        for (uint32_t x = 1; x <= limit; ++x) {
+            auto inv = 1.0 / x;
+            for (size_t l = 0; l < width; ++l) {
+                out[base + l] += (u[l] > f[l]) ? 1u : 0u;
+                p[l] *= m[l] * inv;
+                f[l] += p[l];
+            }
+        }
+        for (size_t l = 0; l < width; ++l) {
+            if (mu[base + l] >= 10.0f) out[base + l] = samplePoisson(gen, mu[base + l]);
+        }
+    }
+}
+
+#endif /*HPP_SAMPLING*/
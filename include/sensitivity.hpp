@@ -0,0 +1,302 @@
+#ifndef HPP_SENSITIVITY
+#define HPP_SENSITIVITY
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "counterrng.hpp"
+#include "hostmap.hpp"
+#include "parallel.hpp"
+
+/// <summary>
+/// Variance-based (Sobol) sensitivity of outbreak outcomes to the parameters of <c>Pathogen</c>.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Saltelli design: two independent sample matrices A and B over the varied
+/// factors, plus, for every factor i, the matrix AB_i that is A with column
+/// i taken from B. Every row costs <c>d + 2</c> runs, and each run feeds the
+/// estimators of every factor and of both outputs: first-order indices by
+/// Saltelli et al. (2010) and total indices by Jansen (1999). The design
+/// points of a row share one random key (see <c>HostMap::setRandomKey</c>),
+/// so the differences between them reflect the factors rather than noise.
+/// </para>
+/// <para>
+/// Design points are derived from the seed and the run index alone, so a
+/// study can be extended to more rows or resumed after an interruption: each
+/// completed batch is appended to a CSV file, and runs already in that file
+/// are skipped. The file starts with a line describing the seed and factor
+/// ranges, which must match when resuming.
+/// </para>
+/// <para>
+/// Integer factors are rounded, and the average incubation and infection
+/// times are raised to their minimums if a sample falls below them.
+/// </para>
+/// </remarks>
+class SobolAnalysis
+{
+public:
+    /// <summary>Parameters of the <c>Pathogen</c> constructor, in order.</summary>
+    enum Factor { TransmissionProb, DeathProb, MinIncubation, MeanIncubation, MinInfection, MeanInfection,
+        Contacts, QuarantineDelay, FactorCount };
+
+    /// <summary>Outcomes whose variance is decomposed.</summary>
+    enum Output { FinalSize, PeakDay, OutputCount };
+
+    /// <summary>
+    /// Sensitivity indices of one output, one entry per varied factor (see <c>factors</c>).
+    /// </summary>
+    struct Indices
+    {
+        std::vector<double> first;      ///< first-order indices
+        std::vector<double> total;      ///< total-effect indices
+        double variance = 0.0;          ///< variance of the output over the design
+        unsigned samples = 0;           ///< complete rows used
+    };
+
+    /// <summary>
+    /// Initialize a study in which every factor is fixed at the defaults of <c>Pathogen</c>.
+    /// </summary>
+    /// <param name="r">number of rows in each map</param>
+    /// <param name="c">number of columns in each map</param>
+    /// <param name="horizon">maximum number of days simulated per run</param>
+    /// <param name="setup">prepares a freshly reset map, e.g., by seeding</param>
+    /// <param name="seed">seed of the design</param>
+    SobolAnalysis(int r, int c, unsigned horizon, std::function<void(HostMap&)> setup, uint64_t seed = 1)
+        : rows(r), cols(c), horizon(horizon), setup(std::move(setup)), seed(seed)
+    {
+        ranges = { {
+            { 0.005, 0.005 }, { 0.5, 0.5 }, { 2, 2 }, { 9, 9 }, { 7, 7 }, { 9, 9 }, { 16, 16 }, { 1, 1 }
+        } };
+    }
+
+    /// <summary>
+    /// Vary a factor uniformly over a range (equal bounds fix it and leave it out of the design).
+    /// </summary>
+    void setRange(Factor f, double lower, double upper) { ranges[f] = { lower, upper }; }
+
+    /// <summary>Factors varied in the design, in the order of the indices.</summary>
+    std::vector<Factor> factors() const
+    {
+        std::vector<Factor> v;
+        for (int f = 0; f < FactorCount; ++f) {
+            if (ranges[f].first != ranges[f].second) v.push_back(static_cast<Factor>(f));
+        }
+        return v;
+    }
+
+    /// <summary>Number of runs per row of the design.</summary>
+    unsigned runsPerSample() const { return static_cast<unsigned>(factors().size()) + 2; }
+
+    /// <summary>
+    /// Build the pathogen for a vector of factor values.
+    /// </summary>
+    /// <param name="x">one value per factor, in the order of <c>Factor</c></param>
+    static Pathogen pathogen(std::array<double, FactorCount> const& x)
+    {
+        auto minE = static_cast<short>(std::lround(x[MinIncubation]));
+        auto minI = static_cast<short>(std::lround(x[MinInfection]));
+        return Pathogen("sobol", x[TransmissionProb], x[DeathProb],
+            minE, std::max(minE, static_cast<short>(std::lround(x[MeanIncubation]))),
+            minI, std::max(minI, static_cast<short>(std::lround(x[MeanInfection]))),
+            static_cast<short>(std::lround(x[Contacts])), static_cast<short>(std::lround(x[QuarantineDelay])));
+    }
+
+    /// <summary>
+    /// Factor values of a run of the design.
+    /// </summary>
+    /// <param name="run">index of the run: row <c>run / runsPerSample()</c>, then A, B, AB_1, ...</param>
+    std::array<double, FactorCount> point(uint64_t run) const
+    {
+        auto varied = factors();
+        auto d = varied.size();
+        auto row = run / (d + 2), m = run % (d + 2);
+        std::array<double, FactorCount> x;
+        for (int f = 0; f < FactorCount; ++f) x[f] = ranges[f].first;
+        for (size_t i = 0; i < d; ++i) {
+            bool fromB = m == 1 || (m >= 2 && m - 2 == i);
+            auto u = (mixKey(mixKey(seed, row), 2 * i + fromB) >> 11) / 9007199254740992.0;
+            auto const& range = ranges[varied[i]];
+            x[varied[i]] = range.first + (range.second - range.first) * u;
+        }
+        return x;
+    }
+
+    /// <summary>
+    /// Run the missing runs of the first rows of the design, appending results to a file.
+    /// </summary>
+    /// <param name="samples">number of rows N; the design has <c>N * runsPerSample()</c> runs</param>
+    /// <param name="path">results file, created if missing and resumed otherwise</param>
+    /// <param name="workers">number of threads (0 for <c>workerCount()</c>)</param>
+    /// <param name="batch">runs between writes to the file (0 for 16 per worker)</param>
+    /// <returns>the number of runs performed by this call</returns>
+    size_t run(unsigned samples, std::string const& path, unsigned workers = 0, unsigned batch = 0)
+    {
+        workers = workers ? workers : workerCount();
+        batch = batch ? batch : 16 * workers;
+        load(path);
+
+        auto total = static_cast<uint64_t>(samples) * runsPerSample();
+        std::vector<uint64_t> pending;
+        for (uint64_t k = 0; k < total; ++k) {
+            if (k >= done.size() || !done[k]) pending.push_back(k);
+        }
+        if (done.size() < total) {
+            done.resize(total, false);
+            results.resize(total);
+        }
+
+        // After an interruption mid-line, rewrite the file without the cut line.
+        std::ofstream os(path, empty || partial ? std::ios::trunc : std::ios::app);
+        if (!os) throw std::runtime_error("SobolAnalysis: unable to write " + path);
+        os.precision(17);
+        if (empty || partial) {
+            os << header() << "\nrun,finalSize,peakDay\n";
+            for (uint64_t k = 0; k < done.size(); ++k) {
+                if (done[k]) os << k << ',' << results[k][FinalSize] << ',' << results[k][PeakDay] << '\n';
+            }
+            empty = partial = false;
+        }
+        for (size_t lo = 0; lo < pending.size(); lo += batch) {
+            auto hi = std::min(pending.size(), lo + batch);
+            parallelFor(lo, hi, [&](size_t a, size_t b, unsigned) {
+                for (auto k = a; k < b; ++k) results[pending[k]] = simulate(pending[k]);
+            }, workers);
+            for (auto k = lo; k < hi; ++k) {
+                auto const& y = results[pending[k]];
+                os << pending[k] << ',' << y[FinalSize] << ',' << y[PeakDay] << '\n';
+                done[pending[k]] = true;
+            }
+            os.flush();
+        }
+        return pending.size();
+    }
+
+    /// <summary>
+    /// Estimate the sensitivity indices of an output from every complete row.
+    /// </summary>
+    /// <param name="output">which output</param>
+    Indices indices(Output output) const
+    {
+        auto d = factors().size();
+        Indices s;
+        s.first.assign(d, 0.0);
+        s.total.assign(d, 0.0);
+
+        // Mean and variance over A and B, by Welford's method.
+        double mean = 0, m2 = 0;
+        unsigned n = 0;
+        auto add = [&](double y) {
+            auto delta = y - mean;
+            mean += delta / ++n;
+            m2 += delta * (y - mean);
+        };
+        for (size_t row = 0; (row + 1) * (d + 2) <= done.size(); ++row) {
+            auto base = row * (d + 2);
+            if (!std::all_of(done.begin() + base, done.begin() + base + d + 2, [](bool b) { return b; })) continue;
+            auto a = results[base][output], b = results[base + 1][output];
+            add(a);
+            add(b);
+            for (size_t i = 0; i < d; ++i) {
+                auto ab = results[base + 2 + i][output];
+                s.first[i] += b * (ab - a);
+                s.total[i] += (a - ab) * (a - ab);
+            }
+            ++s.samples;
+        }
+        s.variance = n > 1 ? m2 / (n - 1) : 0.0;
+        for (size_t i = 0; i < d; ++i) {
+            s.first[i] = s.variance > 0 ? s.first[i] / s.samples / s.variance : 0.0;
+            s.total[i] = s.variance > 0 ? s.total[i] / (2.0 * s.samples * s.variance) : 0.0;
+        }
+        return s;
+    }
+
+private:
+    using Result = std::array<double, OutputCount>;
+
+    Result simulate(uint64_t run) const
+    {
+        auto row = run / runsPerSample();
+        HostMap map(pathogen(point(run)), rows, cols);
+        map.setRandomKey(mixKey(seed ^ 0x5bd1e995ull, row));
+        map.reset();
+        if (setup) setup(map);
+        int peak = map.countInfected();
+        unsigned peakDay = 0;
+        for (unsigned t = 0; t < horizon && map.countInfected() > 0; ++t) {
+            map.computeNext();
+            if (map.countInfected() > peak) {
+                peak = map.countInfected();
+                peakDay = map.getDay();
+            }
+        }
+        return { { static_cast<double>(map.countCumulative()), static_cast<double>(peakDay) } };
+    }
+
+    std::string header() const
+    {
+        std::ostringstream os;
+        os.precision(17);
+        os << "# saltelli seed=" << seed;
+        for (auto const& r : ranges) os << ' ' << r.first << ':' << r.second;
+        return os.str();
+    }
+
+    /// <summary>
+    /// Read the runs completed by an earlier call, possibly in another process.
+    /// </summary>
+    void load(std::string const& path)
+    {
+        done.clear();
+        results.clear();
+        partial = false;
+        std::ifstream is(path);
+        std::string line;
+        // A file cut short within its two header lines holds no results yet.
+        empty = !is || !std::getline(is, line) || is.eof();
+        if (empty) return;
+        if (line != header()) throw std::runtime_error("SobolAnalysis: " + path + " belongs to another design");
+        empty = !std::getline(is, line) || is.eof();
+        if (empty) return;
+        while (std::getline(is, line)) {
+            // A last line cut short by an interruption is ignored, and its run repeated.
+            if (is.eof()) {
+                partial = !line.empty();
+                break;
+            }
+            std::istringstream fields(line);
+            uint64_t k;
+            char comma;
+            Result y;
+            if (!(fields >> k >> comma >> y[FinalSize] >> comma >> y[PeakDay])) continue;
+            if (k >= done.size()) {
+                done.resize(k + 1, false);
+                results.resize(k + 1);
+            }
+            done[k] = true;
+            results[k] = y;
+        }
+    }
+
+    int rows;
+    int cols;
+    unsigned horizon;
+    std::function<void(HostMap&)> setup;
+    uint64_t seed;
+    std::array<std::pair<double, double>, FactorCount> ranges;
+    std::vector<bool> done;
+    std::vector<Result> results;
+    bool empty = true;
+    bool partial = false;
+};
+
+#endif /*HPP_SENSITIVITY*/
@@ -0,0 +1,314 @@
+#ifndef HPP_SPLITTING
+#define HPP_SPLITTING
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+#include "counterrng.hpp"
+#include "hostmap.hpp"
+#include "parallel.hpp"
+
+/// <summary>
+/// Estimate of a rare-event probability by multilevel splitting.
+/// </summary>
+struct SplittingResult
+{
+    double probability = 0.0;           ///< product of the conditional probabilities of all stages
+    double relativeError = 0.0;         ///< approximate relative standard error of the estimate
+    std::vector<double> stages;         ///< conditional probability of reaching each level from the previous one
+    unsigned long long days = 0;        ///< days simulated over every trajectory
+};
+
+/// <summary>
+/// Estimates the probability that an outbreak reaches a score that naive replicates rarely reach.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Fixed-effort multilevel splitting: the target is approached through
+/// increasing intermediate levels of a score (by default cumulative
+/// infections). Each stage runs a fixed number of trajectories; the maps of
+/// those that reach the next level are kept, and the next stage restarts
+/// from copies of them with fresh random numbers. The estimate is the product
+/// of the fraction of successes of every stage. Effort is spent on the
+/// trajectories that are still heading toward the target, so the number of
+/// simulated days grows with the number of levels rather than with the
+/// inverse of the probability.
+/// </para>
+/// <para>
+/// A trajectory fails when its outbreak dies out, when the horizon is
+/// reached, or (if a patience is set) when its score has not grown for that
+/// many days. Extinction and the horizon are exact; pruning stalled runs
+/// saves time but slightly underestimates the probability if stalled runs
+/// could still recover.
+/// </para>
+/// <para>
+/// Every trajectory of the first stage starts from one population (the
+/// contacts of every host), drawn once per run. Kept maps are copy-on-write
+/// images: the grid is split into bands of <c>HostMap::tile_size</c> rows,
+/// and an image shares with the state its trajectory started from every
+/// band the trajectory did not write to. A stage therefore holds memory in
+/// proportion to the area its outbreaks touched rather than to the number
+/// of trajectories, and restarting a worker only copies the bands that
+/// differ from what it already holds. Writes are detected through the
+/// notifications of the map, so <c>setup</c> must change the map through
+/// its methods rather than by editing cells. Images do not keep observers.
+/// Other events, such as extinction after an intervention, can be targeted
+/// with a score that grows toward them.
+/// </para>
+/// <para>
+/// Reference: Garvels and Kroese, "A comparison of RESTART implementations"
+/// (1998); Cérou et al., "Sequential Monte Carlo for rare event estimation"
+/// (2012).
+/// </para>
+/// </remarks>
+class Splitting
+{
+public:
+    /// <summary>
+    /// Initialize a splitting estimator for a scenario.
+    /// </summary>
+    /// <param name="disease">representation of a communicable disease</param>
+    /// <param name="r">number of rows in each map</param>
+    /// <param name="c">number of columns in each map</param>
+    /// <param name="horizon">last day by which the target must be reached</param>
+    /// <param name="setup">prepares a freshly reset map for a given initial trajectory</param>
+    /// <param name="levels">increasing score levels; the last one is the target</param>
+    /// <param name="score">score of a map (default: cumulative infections)</param>
+    Splitting(Pathogen const& disease, int r, int c, unsigned horizon,
+        std::function<void(HostMap&, unsigned)> setup, std::vector<double> levels,
+        std::function<double(HostMap const&)> score = [](HostMap const& m) {
+            return static_cast<double>(m.countCumulative());
+        })
+        : disease(disease), rows(r), cols(c), horizon(horizon), setup(std::move(setup)),
+        levels(std::move(levels)), score(std::move(score))
+    {}
+
+    /// <summary>
+    /// Set the number of trajectories run in each stage (default 200).
+    /// </summary>
+    void setEffort(unsigned n) { effort = std::max(n, 1u); }
+
+    /// <summary>
+    /// Prune trajectories whose score has not grown for a number of days (0 to disable, the default).
+    /// </summary>
+    void setPatience(unsigned days) { patience = days; }
+
+    /// <summary>
+    /// Make the estimate reproducible by drawing every trajectory from keyed streams.
+    /// </summary>
+    /// <param name="base">key from which the key of every trajectory is derived</param>
+    void setKey(uint64_t base)
+    {
+        key = base;
+        keyed = true;
+    }
+
+    /// <summary>
+    /// Run every stage.
+    /// </summary>
+    /// <param name="workers">number of threads (0 for <c>workerCount()</c>)</param>
+    /// <returns>the estimate, which is 0 if some stage had no success</returns>
+    SplittingResult run(unsigned workers = 0)
+    {
+        workers = std::min(workers ? workers : workerCount(), effort);
+        SplittingResult result;
+        std::atomic<unsigned long long> days(0);
+        std::vector<std::unique_ptr<Worker>> pool;
+        for (unsigned w = 0; w < workers; ++w) pool.emplace_back(new Worker(disease, rows, cols));
+
+        // The population shared by the first stage.
+        auto& first = pool[0]->map;
+        if (keyed) first.setRandomKey(key);
+        first.reset();
+        std::vector<Image> starts;
+        starts.push_back(capture(*pool[0]));
+
+        std::vector<std::pair<unsigned, Image>> hits;       // trajectory index, map at the level
+        std::default_random_engine shuffle(keyed ? static_cast<unsigned>(mixKey(key, 0)) : std::random_device()());
+        double variance = 0.0;
+        result.probability = 1.0;
+
+        for (size_t k = 0; k < levels.size(); ++k) {
+            // Balanced restarts: every kept state is reused equally often.
+            std::vector<size_t> order(effort);
+            for (unsigned n = 0; n < effort; ++n) order[n] = n % starts.size();
+            std::shuffle(order.begin(), order.end(), shuffle);
+
+            hits.clear();
+            std::mutex mutex;
+            std::atomic<unsigned> next(0);
+            parallelFor(0, workers, [&](size_t, size_t, unsigned w) {
+                auto& worker = *pool[w];
+                auto& map = worker.map;
+                unsigned long long simulated = 0;
+                for (auto n = next++; n < effort; n = next++) {
+                    restore(worker, starts[order[n]]);
+                    if (keyed) map.setRandomKey(mixKey(key + k, n));
+                    else map.clearRandomKey();
+                    if (k == 0 && setup) setup(map, n);
+                    if (advance(map, levels[k], simulated)) {
+                        auto image = capture(worker);
+                        std::lock_guard<std::mutex> lock(mutex);
+                        hits.emplace_back(n, std::move(image));
+                    }
+                }
+                days += simulated;
+            }, workers);
+
+            auto p = static_cast<double>(hits.size()) / effort;
+            result.stages.push_back(p);
+            result.probability *= p;
+            if (hits.empty()) break;
+            variance += (1 - p) / (effort * p);
+
+            // Order the kept maps by trajectory, not by finishing time, so a keyed run is reproducible.
+            std::sort(hits.begin(), hits.end(), [](auto const& a, auto const& b) {
+                return a.first < b.first;
+            });
+            starts.clear();
+            for (auto& h : hits) starts.push_back(std::move(h.second));
+        }
+        result.relativeError = result.probability > 0 ? std::sqrt(variance) : 0.0;
+        result.days = days;
+        return result;
+    }
+
+private:
+    using Grid = std::vector<std::vector<Host>>;
+    using Band = std::vector<Host>;
+
+    /// <summary>
+    /// Copy-on-write image of a map.
+    /// </summary>
+    struct Image
+    {
+        HostMap state;                                  // everything but the grid, which is left empty
+        std::vector<std::shared_ptr<Band const>> bands; // rows of the grid, tile_size at a time
+    };
+
+    /// <summary>
+    /// Map advanced by one thread, with the image every band of its grid was last restored from.
+    /// </summary>
+    struct Worker : InfectionObserver
+    {
+        HostMap map;
+        std::vector<std::shared_ptr<Band const>> held;  // image band matching each band of the grid
+        std::vector<char> dirty;                        // bands written since they were restored
+        int cols;
+
+        Worker(Pathogen const& disease, int r, int c)
+            : map(disease, r, c), held((r + HostMap::tile_size - 1) / HostMap::tile_size),
+            dirty(held.size(), 1), cols(c)
+        {
+            map.addObserver(this);
+        }
+
+        void touch(int k) { dirty[k / cols / HostMap::tile_size] = 1; }
+        void onInfection(unsigned, int, int infectee) override { touch(infectee); }
+        void onTransition(int k, int, int) override { touch(k); }
+        void onReset() override { std::fill(dirty.begin(), dirty.end(), 1); }
+        void onRegionChanged(HostMap const&, Region r) override
+        {
+            for (auto i = r.row; i < r.row + r.rows; ++i) dirty[i / HostMap::tile_size] = 1;
+        }
+    };
+
+    /// <summary>
+    /// Take an image of the map of a worker, sharing the bands it has not written since its last restore.
+    /// </summary>
+    static Image capture(Worker& w)
+    {
+        Grid& grid = w.map;
+        Grid rows;
+        rows.swap(grid);
+        Image image{ w.map, {} };
+        rows.swap(grid);
+        image.state.clearObservers();
+        image.bands.resize(w.held.size());
+        for (size_t b = 0; b < w.held.size(); ++b) {
+            if (!w.dirty[b] && w.held[b]) {
+                image.bands[b] = w.held[b];
+                continue;
+            }
+            auto band = std::make_shared<Band>();
+            auto end = std::min(grid.size(), (b + 1) * HostMap::tile_size);
+            for (auto i = b * HostMap::tile_size; i < end; ++i) band->insert(band->end(), grid[i].begin(), grid[i].end());
+            image.bands[b] = band;
+        }
+        return image;
+    }
+
+    /// <summary>
+    /// Load an image into the map of a worker, copying only the bands that differ from those it holds.
+    /// </summary>
+    static void restore(Worker& w, Image const& image)
+    {
+        Grid& grid = w.map;
+        Grid rows;
+        rows.swap(grid);
+        w.map = image.state;
+        rows.swap(grid);
+        w.map.addObserver(&w);
+        for (size_t b = 0; b < w.held.size(); ++b) {
+            if (!w.dirty[b] && w.held[b] == image.bands[b]) continue;
+            auto cell = image.bands[b]->begin();
+            auto end = std::min(grid.size(), (b + 1) * HostMap::tile_size);
+            for (auto i = b * HostMap::tile_size; i < end; ++i) {
+                std::copy(cell, cell + grid[i].size(), grid[i].begin());
+                cell += grid[i].size();
+            }
+            w.held[b] = image.bands[b];
+            w.dirty[b] = 0;
+        }
+        // Active hosts advance without notification, so their bands are written from the first day.
+        for (auto const* list : { &w.map.incubatingHosts(), &w.map.spreadingHosts(), &w.map.isolatedHosts() }) {
+            for (auto k : *list) w.touch(k);
+        }
+    }
+
+    /// <summary>
+    /// Simulate a map until its score reaches a level or the trajectory fails.
+    /// </summary>
+    /// <returns>true if the level was reached</returns>
+    bool advance(HostMap& map, double level, unsigned long long& simulated) const
+    {
+        auto best = score(map);
+        auto since = 0u;
+        while (best < level) {
+            if (map.countInfected() == 0 || map.getDay() >= horizon) return false;
+            if (patience && since >= patience) return false;
+            map.computeNext();
+            ++simulated;
+            auto s = score(map);
+            if (s > best) {
+                best = s;
+                since = 0;
+            }
+            else {
+                ++since;
+            }
+        }
+        return true;
+    }
+
+    Pathogen disease;
+    int rows;
+    int cols;
+    unsigned horizon;
+    std::function<void(HostMap&, unsigned)> setup;
+    std::vector<double> levels;
+    std::function<double(HostMap const&)> score;
+    unsigned effort = 200;
+    unsigned patience = 0;
+    bool keyed = false;
+    uint64_t key = 0;
+};
+
+#endif /*HPP_SPLITTING*/
@@ -0,0 +1,180 @@
+#ifndef HPP_STOPPING
+#define HPP_STOPPING
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ensemble.hpp"
+
+/// <summary>
+/// Running mean and variance, by Welford's method.
+/// </summary>
+struct RunningStats
+{
+    unsigned n = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+
+    /// <summary>Add an observation.</summary>
+    void add(double x)
+    {
+        ++n;
+        auto d = x - mean;
+        mean += d / n;
+        m2 += d * (x - mean);
+    }
+
+    /// <summary>Unbiased sample variance, or 0 with fewer than two observations.</summary>
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0.0; }
+
+    /// <summary>Standard error of the mean.</summary>
+    double standardError() const { return n ? std::sqrt(variance() / n) : std::numeric_limits<double>::infinity(); }
+};
+
+/// <summary>
+/// Stops an ensemble once chosen outputs are estimated to a target precision.
+/// </summary>
+/// <remarks>
+/// <para>
+/// After each replicate the final size (cumulative infections), the peak
+/// day (first day of the largest number of active infections) and whether
+/// the outbreak went extinct within the horizon are added to running
+/// statistics. The ensemble stops once every required output has a normal
+/// confidence half-width <c>z * SE</c> within its target, absolute or
+/// relative to the mean, and at least <c>minReplicates</c> have run.
+/// </para>
+/// <para>
+/// The extinction probability is the mean of a 0/1 outcome, so its
+/// half-width is that of the Wilson score interval, which unlike
+/// <c>z * SE</c> stays positive when every outcome so far is the same;
+/// rare events therefore need many replicates before the rule stops.
+/// </para>
+/// </remarks>
+class PrecisionTarget : public EnsembleCollector
+{
+public:
+    /// <summary>Outputs whose precision can be targeted.</summary>
+    enum Output { FinalSize, PeakDay, Extinction, OutputCount };
+
+    /// <summary>
+    /// Initialize a stopping rule with no targets yet.
+    /// </summary>
+    /// <param name="z">critical value of the confidence intervals (1.96 for 95%)</param>
+    /// <param name="minReplicates">replicates to run before stopping is considered</param>
+    explicit PrecisionTarget(double z = 1.96, unsigned minReplicates = 30)
+        : z(z), minReplicates(minReplicates)
+    {
+        targets.fill(-1.0);
+    }
+
+    /// <summary>
+    /// Require an output to reach a given precision.
+    /// </summary>
+    /// <param name="output">which output</param>
+    /// <param name="halfWidth">largest acceptable confidence half-width</param>
+    /// <param name="relative">interpret <c>halfWidth</c> as a fraction of the mean</param>
+    void require(Output output, double halfWidth, bool relative = false)
+    {
+        targets[output] = halfWidth;
+        relatives[output] = relative;
+    }
+
+    void prepare(unsigned workers, size_t, size_t) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.fill(RunningStats());
+        peaks.clear();
+        for (unsigned w = 0; w < workers; ++w) peaks.emplace_back(new Peak);
+    }
+
+    InfectionObserver* observer(unsigned worker) override { return peaks[worker].get(); }
+
+    void replicateDone(HostMap const& map, unsigned, unsigned worker) override
+    {
+        auto const& p = *peaks[worker];
+        std::lock_guard<std::mutex> lock(mutex);
+        stats[FinalSize].add(map.countCumulative());
+        stats[PeakDay].add(p.day);
+        stats[Extinction].add(map.countInfected() == 0 ? 1.0 : 0.0);
+    }
+
+    bool enough() const override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stats[FinalSize].n < minReplicates) return false;
+        for (int k = 0; k < OutputCount; ++k) {
+            if (targets[k] < 0) continue;
+            auto limit = relatives[k] ? targets[k] * std::fabs(stats[k].mean) : targets[k];
+            if (width(k) > limit) return false;
+        }
+        return true;
+    }
+
+    /// <summary>Number of replicates observed.</summary>
+    unsigned replicates() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats[FinalSize].n;
+    }
+
+    /// <summary>Estimated mean of an output (a probability for <c>Extinction</c>).</summary>
+    double mean(Output output) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats[output].mean;
+    }
+
+    /// <summary>Current confidence half-width of an output.</summary>
+    double halfWidth(Output output) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return width(output);
+    }
+
+private:
+    /// <summary>
+    /// Confidence half-width of an output: normal for continuous outputs, Wilson for the 0/1 one.
+    /// </summary>
+    double width(int output) const
+    {
+        auto const& s = stats[output];
+        if (output != Extinction) return z * s.standardError();
+        if (s.n == 0) return std::numeric_limits<double>::infinity();
+        auto n = static_cast<double>(s.n), z2 = z * z;
+        return z / (1 + z2 / n) * std::sqrt(s.mean * (1 - s.mean) / n + z2 / (4 * n * n));
+    }
+
+    /// <summary>
+    /// Tracks the peak of active infections in one worker's current replicate.
+    /// </summary>
+    struct Peak : InfectionObserver
+    {
+        void onInfection(unsigned, int, int) override {}
+
+        void onDayEnd(HostMap const& map) override
+        {
+            if (map.countInfected() > size) {
+                size = map.countInfected();
+                day = map.getDay();
+            }
+        }
+
+        void onReset() override { size = day = 0; }
+
+        int size = 0;
+        unsigned day = 0;
+    };
+
+    double z;
+    unsigned minReplicates;
+    std::array<double, OutputCount> targets;
+    std::array<bool, OutputCount> relatives{};
+    std::array<RunningStats, OutputCount> stats;
+    std::vector<std::unique_ptr<Peak>> peaks;
+    mutable std::mutex mutex;
+};
+
+#endif /*HPP_STOPPING*/
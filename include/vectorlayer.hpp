@@ -0,0 +1,243 @@
+#ifndef HPP_VECTORLAYER
+#define HPP_VECTORLAYER
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "counterrng.hpp"
+#include "hostmap.hpp"
+#include "sampling.hpp"
+
+/// <summary>
+/// Life-cycle and transmission parameters of a disease vector (e.g., mosquitoes).
+/// </summary>
+struct VectorParameters
+{
+    uint32_t perCell = 20;          ///< adult vectors in each cell at equilibrium
+    double mortality = 0.1;         ///< daily probability that an adult vector dies
+    double incubation = 10.0;       ///< mean extrinsic incubation period, in days
+    double biteRate = 0.3;          ///< bites taken by each vector per day
+    double toHost = 0.3;            ///< probability that an infectious bite infects a host
+    double toVector = 0.3;          ///< probability that biting an infectious host infects a vector
+    double dispersal = 0.2;         ///< fraction of bites taken in the four neighboring cells
+};
+
+/// <summary>
+/// Vector population layer on the grid of a <c>HostMap</c>, coupled to it by
+/// cross-species transmission.
+/// </summary>
+/// <remarks>
+/// <para>
+/// Each cell holds counts of susceptible, incubating and infectious vectors
+/// (SEI; vectors never recover). Every day each adult dies with probability
+/// <c>mortality</c> and is replaced by a susceptible newly emerged adult,
+/// incubating vectors become infectious with probability <c>1/incubation</c>,
+/// and susceptible vectors are infected with probability
+/// <c>1 - exp(-biteRate * toVector * h)</c>, where <c>h</c> is the fraction
+/// of infectious hosts they bite. A susceptible host is infected with
+/// probability <c>1 - exp(-biteRate * toHost * v)</c>, where <c>v</c> is the
+/// number of infectious vectors biting in its cell. Both exposures blend the
+/// local cell with its four neighbors by <c>dispersal</c>.
+/// </para>
+/// <para>
+/// Vector counts are stored as 32-bit columns in the same row-major order
+/// as the host grid. Host exposure and the vector update share one parallel
+/// pass over row bands; the hosts found exposed are infected after it, and
+/// the map then advances in its own step. Rows with no infected vectors and
+/// no infectious hosts within one row are skipped, so the layer costs
+/// nothing where the disease is absent. Each row draws from its own stream,
+/// seeded by <c>HostMap::layerSeed</c>, so results are reproducible in paired
+/// mode and do not depend on the number of threads.
+/// </para>
+/// </remarks>
+class VectorLayer
+{
+public:
+    /// <summary>
+    /// Initialize an uninfected vector population aligned with a map.
+    /// </summary>
+    /// <param name="map">the host map this layer is coupled to</param>
+    /// <param name="params">life-cycle and transmission parameters of the vector</param>
+    VectorLayer(HostMap const& map, VectorParameters const& params = VectorParameters())
+        : rows(static_cast<int>(map.row_count())), cols(static_cast<int>(map.col_count())),
+        params(params), S(static_cast<size_t>(rows) * cols), E(S.size()), I(S.size()), nextI(S.size()),
+        active(rows, 0), spare(rows, 0), hosts(rows, 0), infected(workerCount())
+    {
+        reset();
+    }
+
+    /// <summary>Resets every cell to a fully susceptible vector population.</summary>
+    void reset()
+    {
+        std::fill(S.begin(), S.end(), params.perCell);
+        std::fill(E.begin(), E.end(), 0);
+        std::fill(I.begin(), I.end(), 0);
+        std::fill(nextI.begin(), nextI.end(), 0);
+        std::fill(active.begin(), active.end(), 0);
+        std::fill(spare.begin(), spare.end(), 0);
+        infectious = incubating = 0;
+    }
+
+    /// <summary>
+    /// Introduce infectious vectors into a cell.
+    /// </summary>
+    /// <param name="k">row-major index of a cell</param>
+    /// <param name="count">number of susceptible vectors to make infectious</param>
+    void seedVectors(size_t k, uint32_t count)
+    {
+        count = std::min(count, S[k]);
+        S[k] -= count;
+        I[k] += count;
+        infectious += count;
+        active[k / cols] = 1;
+    }
+
+    /// <summary>Susceptible vectors in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t susceptibleAt(size_t k) const { return S[k]; }
+
+    /// <summary>Incubating vectors in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t incubatingAt(size_t k) const { return E[k]; }
+
+    /// <summary>Infectious vectors in a cell.</summary>
+    /// <param name="k">row-major index of a cell</param>
+    uint32_t infectiousAt(size_t k) const { return I[k]; }
+
+    /// <summary>
+    /// Count the number of infected vectors.
+    /// </summary>
+    /// <returns>total number of incubating or infectious vectors in the layer</returns>
+    int64_t countInfected() const { return incubating + infectious; }
+
+    /// <summary>
+    /// Advance both the vectors and the map one day.
+    /// </summary>
+    /// <param name="map">the host map this layer is coupled to</param>
+    void advance(HostMap& map)
+    {
+        std::fill(hosts.begin(), hosts.end(), 0);
+        for (auto const* list : { &map.spreadingHosts(), &map.isolatedHosts() }) {
+            for (auto k : *list) hosts[k / cols] = 1;
+        }
+
+        auto sigma = 1.0 / params.incubation;
+        auto toVector = params.biteRate * params.toVector;
+        auto toHost = params.biteRate * params.toHost;
+        auto seed = map.layerSeed(layerTag);
+        auto& disease = map.getDisease();
+        std::vector<std::array<int64_t, 2>> deltas(infected.size(), std::array<int64_t, 2>{});
+        parallelFor(0, rows, [&](size_t lo, size_t hi, unsigned w) {
+            auto& delta = deltas[w];
+            auto& found = infected[w];
+            found.clear();
+            for (auto i = static_cast<int>(lo); i < static_cast<int>(hi); ++i) {
+                auto up = (i == 0 ? rows : i) - 1, down = (i + 1 == rows ? 0 : i + 1);
+                auto nearHosts = hosts[up] | hosts[i] | hosts[down];
+                auto nearVectors = active[up] | active[i] | active[down];
+                if (!nearHosts && !nearVectors) {
+                    if (spare[i]) {
+                        std::fill(nextI.begin() + static_cast<size_t>(i) * cols,
+                            nextI.begin() + static_cast<size_t>(i + 1) * cols, 0);
+                        spare[i] = 0;
+                    }
+                    continue;
+                }
+                CounterEngine gen(mixKey(seed, i));
+
+                // Hosts first, from the vectors as they were at the start of the day.
+                if (nearVectors) {
+                    auto const& row = map[i];
+                    for (int j = 0; j < cols; ++j) {
+                        if (!disease.isSusceptible(row[j])) continue;
+                        auto v = blend(I, i, j);
+                        if (v > 0 && sampleUniform(gen) < -std::expm1(-toHost * v)) {
+                            found.push_back(i * cols + j);
+                        }
+                    }
+                }
+
+                bool live = false;
+                for (int j = 0; j < cols; ++j) {
+                    auto k = static_cast<size_t>(i) * cols + j;
+                    auto h = nearHosts ? blend(map, disease, i, j) : 0.0;
+                    if (h == 0 && E[k] == 0 && I[k] == 0) {
+                        nextI[k] = 0;
+                        continue;
+                    }
+                    auto newE = sampleBinomial(gen, S[k], -std::expm1(-toVector * h));
+                    auto newI = sampleBinomial(gen, E[k], sigma);
+                    auto deadE = sampleBinomial(gen, E[k] - newI, params.mortality);
+                    auto deadI = sampleBinomial(gen, I[k], params.mortality);
+                    S[k] += deadE + deadI - newE;
+                    E[k] += newE - newI - deadE;
+                    nextI[k] = I[k] + newI - deadI;
+                    delta[0] += static_cast<int64_t>(newE) - newI - deadE;
+                    delta[1] += static_cast<int64_t>(newI) - deadI;
+                    live = live || E[k] > 0 || nextI[k] > 0;
+                }
+                spare[i] = live;
+            }
+        }, static_cast<unsigned>(infected.size()));
+
+        I.swap(nextI);
+        active.swap(spare);
+        for (auto& delta : deltas) {
+            incubating += delta[0];
+            infectious += delta[1];
+        }
+
+        for (auto& found : infected) {
+            for (auto k : found) map.infectHost(k);
+        }
+        map.computeNext();
+    }
+
+private:
+    static constexpr uint64_t layerTag = 0x76656374;      // "vect"
+
+    /// <summary>
+    /// Infectious vectors biting in cell (i,j), including dispersal from its neighbors.
+    /// </summary>
+    double blend(std::vector<uint32_t> const& v, int i, int j) const
+    {
+        auto up = (i == 0 ? rows : i) - 1, down = (i + 1 == rows ? 0 : i + 1);
+        auto left = (j == 0 ? cols : j) - 1, right = (j + 1 == cols ? 0 : j + 1);
+        double local = v[static_cast<size_t>(i) * cols + j];
+        if (params.dispersal <= 0) return local;
+        double nbrs = v[static_cast<size_t>(up) * cols + j] + v[static_cast<size_t>(down) * cols + j]
+            + v[static_cast<size_t>(i) * cols + left] + v[static_cast<size_t>(i) * cols + right];
+        return (1 - params.dispersal) * local + params.dispersal * nbrs / 4;
+    }
+
+    /// <summary>
+    /// Fraction of infectious hosts bitten by vectors in cell (i,j), including dispersal.
+    /// </summary>
+    double blend(HostMap const& map, Pathogen const& disease, int i, int j) const
+    {
+        auto up = (i == 0 ? rows : i) - 1, down = (i + 1 == rows ? 0 : i + 1);
+        auto left = (j == 0 ? cols : j) - 1, right = (j + 1 == cols ? 0 : j + 1);
+        auto sick = [&](int r, int c) { return disease.isInfectious(map[r][c]) ? 1.0 : 0.0; };
+        auto local = sick(i, j);
+        if (params.dispersal <= 0) return local;
+        auto nbrs = sick(up, j) + sick(down, j) + sick(i, left) + sick(i, right);
+        return (1 - params.dispersal) * local + params.dispersal * nbrs / 4;
+    }
+
+    int rows;
+    int cols;
+    VectorParameters params;
+    std::vector<uint32_t> S;
+    std::vector<uint32_t> E;
+    std::vector<uint32_t> I;
+    std::vector<uint32_t> nextI;        // infectious counts for the next day, read by neighbors
+    std::vector<uint8_t> active;        // rows holding infected vectors
+    std::vector<uint8_t> spare;         // same for the rows of nextI
+    std::vector<uint8_t> hosts;         // rows holding infectious hosts
+    std::vector<std::vector<int>> infected;
+    int64_t incubating = 0;
+    int64_t infectious = 0;
+};
+
+#endif /*HPP_VECTORLAYER*/
@@ -10,6 +10,8 @@ vec4 colorE = vec4(1, 1, 0, 1);
 vec4 colorI = vec4(1, 0, 0, 1);
 vec4 colorR = vec4(0, 1, 0, 1);
 vec4 colorD = vec4(0, 0, 0, 1);
+vec4 colorV = vec4(0.5, 0.5, 0.5, 1);
+vec4 colorM = vec4(0, 1, 1, 1);
 
 void main() 
 {
@@ -25,6 +27,10 @@ void main()
 		fColor = colorR;
 	} else if (vState[2] == 5) {
 		fColor = colorD;
+	} else if (vState[2] == 6) {
+		fColor = colorV;
+	} else if (vState[2] == 7) {
+		fColor = colorM;
 	} else {
 		fColor = vec4(1, 1, 1, 1);
 	}
@@ -1,5 +1,6 @@
 #include "Angel.h"
 #include "hostmap.hpp"
+#include "regionindex.hpp"
 
 //-- Static functions and data for convenience -------------------------------
 
@@ -10,6 +11,7 @@
 struct Scenario
 {
     static HostMap* map;
+    static RegionIndex* index;
     static Pathogen disease;
     static unsigned int T;
     static unsigned int M;
@@ -34,6 +36,7 @@ struct Scenario
 };
 
 HostMap* Scenario::map;
+RegionIndex* Scenario::index;
 Pathogen Scenario::disease;
 unsigned int Scenario::T;
 unsigned int Scenario::M;
@@ -46,6 +49,8 @@ struct VisCallbacks
 {
     static long N;
     static vec2* points;
+    static int dragRow;
+    static int dragCol;
 
     static void display(void)
     {
@@ -66,6 +71,35 @@ struct VisCallbacks
         }
     }
 
+    /// <summary>
+    /// Drag a rectangle with the left mouse button to print host counts within it.
+    /// </summary>
+    static void mouse(int button, int state, int x, int y)
+    {
+        if (button != GLUT_LEFT_BUTTON) return;
+        HostMap const& map = *Scenario::map;
+        auto i = static_cast<int>(y * static_cast<long>(map.row_count()) / glutGet(GLUT_WINDOW_HEIGHT));
+        auto j = static_cast<int>(x * static_cast<long>(map.col_count()) / glutGet(GLUT_WINDOW_WIDTH));
+        if (state == GLUT_DOWN) {
+            dragRow = i;
+            dragCol = j;
+            return;
+        }
+        Region r;
+        r.row = std::min(i, dragRow);
+        r.col = std::min(j, dragCol);
+        r.rows = std::abs(i - dragRow) + 1;
+        r.cols = std::abs(j - dragCol) + 1;
+        auto c = Scenario::index->counts(r);
+        std::cout << "\n[" << r.row << "," << r.col << " " << r.rows << "x" << r.cols << "] "
+            << c.susceptible << " susceptible, "
+            << c.exposed << " exposed, "
+            << c.infectious << " infectious, "
+            << c.recovered << " recovered, "
+            << c.deceased << " died"
+            << std::endl;
+    }
+
     static void init(int h, int w)
     {
         N = h * w;
@@ -145,6 +179,8 @@ struct VisCallbacks
 
 long VisCallbacks::N;
 vec2* VisCallbacks::points = nullptr;
+int VisCallbacks::dragRow;
+int VisCallbacks::dragCol;
 
 //-- USAGE INSTRUCTIONS ------------------------------------------------------
 
@@ -161,7 +197,7 @@ void printUsage(char* progName)
         << "   <tmin-infected> [7]\n"
         << "   <tavg-infected> [9]\n"
         << "   <num-contacts> [17]\n"
-        << "   <quarantine-delay> [0] (currently unused)\n"
+        << "   <quarantine-delay> [0] (negative disables)\n"
         << "   <num-seeds> [1]\n"
         << "   <step-size> [1]\n";
 }
@@ -215,11 +251,16 @@ int main(int argc, char** argv)
         glewExperimental = GL_TRUE;
         glewInit();
 
+        RegionIndex index(map);
+        map.addObserver(&index);
+        Scenario::index = &index;
+
         vec2* points = new vec2[N * N];
         VisCallbacks::points = points;
         VisCallbacks::init(static_cast<int>(map.row_count()), static_cast<int>(map.col_count()));
         glutDisplayFunc(VisCallbacks::display);
         glutKeyboardFunc(VisCallbacks::keyboard);
+        glutMouseFunc(VisCallbacks::mouse);
         glutTimerFunc(17, VisCallbacks::update, 0);
 
         glutMainLoop();
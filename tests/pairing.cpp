@@ -0,0 +1,144 @@
+/*
+    Reproducibility tests of paired (common random numbers) mode.
+
+    A paired ensemble is run with one worker and with several, and every
+    replicate must end in exactly the same state: with each replicate keyed
+    by its index, the outcome may not depend on which worker ran it or on how
+    many threads there are. Layers coupled to a map (contamination, vectors)
+    and the other engines are checked the same way, by running the same key
+    twice.
+*/
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "compartmentmodel.hpp"
+#include "contamination.hpp"
+#include "ensemble.hpp"
+#include "hybridmap.hpp"
+#include "multihostmap.hpp"
+#include "vectorlayer.hpp"
+
+namespace {
+
+constexpr uint64_t key = 0x5eed;
+
+/// <summary>Records the final counts of every replicate.</summary>
+class Outcomes : public EnsembleCollector
+{
+public:
+    explicit Outcomes(unsigned replicates) : results(replicates) {}
+
+    void replicateDone(HostMap const& map, unsigned replicate, unsigned) override
+    {
+        results[replicate] = { map.countCumulative(), map.countDeceased(), map.countRecovered(),
+            map.countImmunized(), static_cast<int>(map.getDay()) };
+    }
+
+    std::vector<std::vector<int>> results;
+};
+
+/// <summary>
+/// Print and return the result of a case.
+/// </summary>
+bool report(std::string const& name, bool ok)
+{
+    std::cout << (ok ? "pass " : "FAIL ") << name << "\n";
+    return ok;
+}
+
+/// <summary>Run a paired ensemble with a given number of workers.</summary>
+std::vector<std::vector<int>> ensemble(unsigned workers)
+{
+    constexpr unsigned replicates = 12;
+    Ensemble e(Pathogen("Ebola", 0.05), 60, 60, 80, [](HostMap& map, unsigned) {
+        map.vaccinate(Region{ 0, 0, 20, 60 }, 0.5);
+        map.importCases(Region{ 30, 30, 10, 10 }, 3);
+    });
+    e.setPairedKey(key);
+    Outcomes outcomes(replicates);
+    e.addCollector(&outcomes);
+    e.run(replicates, workers);
+    return outcomes.results;
+}
+
+bool ensembles()
+{
+    auto one = ensemble(1);
+    return report("paired ensemble: 1 and 4 workers agree", one == ensemble(4))
+        & report("paired ensemble: replicates differ", one.front() != one.back());
+}
+
+/// <summary>Final state of a map run with a contamination field under the key.</summary>
+std::vector<int> contamination()
+{
+    HostMap map(Pathogen("Ebola", 0.02), 80, 80);
+    map.setRandomKey(key);
+    map.reset();
+    map.seedDisease(5);
+    ContaminationField field(map, 1.0f, 0.2f, 0.1f, 0.05f);
+    for (int t = 0; t < 60; ++t) field.advance(map);
+    return { map.countCumulative(), map.countDeceased(), map.countRecovered() };
+}
+
+/// <summary>Final state of a map run with a vector layer under the key.</summary>
+std::vector<long long> vectors()
+{
+    HostMap map(Pathogen("Ebola", 0.0), 60, 60);
+    map.setRandomKey(key);
+    map.reset();
+    VectorLayer layer(map);
+    layer.seedVectors(30 * 60 + 30, 40);
+    for (int t = 0; t < 60; ++t) layer.advance(map);
+    return { map.countCumulative(), map.countDeceased(), layer.countInfected() };
+}
+
+std::vector<long long> hybrid()
+{
+    HybridMap map(Pathogen("Ebola", 0.05), 96, 96);
+    map.setRandomKey(key);
+    map.reset();
+    map.seedDisease(5);
+    for (int t = 0; t < 60; ++t) map.computeNext();
+    return { map.countInfected(), map.countDeceased(), map.countRecovered() };
+}
+
+std::vector<long long> compartments()
+{
+    ModelMap map(CompartmentModel::seird(Pathogen("Ebola", 0.05)), 60, 60);
+    map.setRandomKey(key);
+    map.reset();
+    map.seedDisease(5);
+    for (int t = 0; t < 60; ++t) map.computeNext();
+    std::vector<long long> counts;
+    for (int s = 0; s < 5; ++s) counts.push_back(map.count(s));
+    counts.push_back(map.countActive());
+    return counts;
+}
+
+std::vector<int> multihost()
+{
+    MultiHostMap<2> map({ Pathogen("Ebola", 0.05), Pathogen("Flu", 0.05) }, 60, 60);
+    map.setCrossImmunity(0, 1, 0.5);
+    map.setInterference(1, 0, 0.5);
+    map.setRandomKey(key);
+    map.reset();
+    map.seedDisease(0, 5);
+    map.seedDisease(1, 5);
+    for (int t = 0; t < 60; ++t) map.computeNext();
+    return { map.countRecovered(0), map.countDeceased(0), map.countRecovered(1), map.countDeceased(1) };
+}
+
+}
+
+int main()
+{
+    bool ok = ensembles();
+    ok &= report("contamination: same key, same outcome", contamination() == contamination());
+    ok &= report("vector layer: same key, same outcome", vectors() == vectors());
+    ok &= report("hybrid map: same key, same outcome", hybrid() == hybrid());
+    ok &= report("compartment model: same key, same outcome", compartments() == compartments());
+    ok &= report("multi-host map: same key, same outcome", multihost() == multihost());
+    return ok ? 0 : 1;
+}
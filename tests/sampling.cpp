@@ -0,0 +1,150 @@
+/*
+    Accuracy tests of the samplers in sampling.hpp.
+
+    Each case draws from a sampler, batched or not, and from the matching
+    standard library distribution, and compares them with a two-sample
+    chi-square test of homogeneity (values binned so that every bin expects
+    at least 10 draws) and with the exact mean and variance. Engines are seeded with fixed
+    values, so the test is deterministic. The log-factorial used by the
+    rejection samplers is checked against std::lgamma.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "sampling.hpp"
+
+namespace {
+
+constexpr int draws = 400000;
+
+/// <summary>
+/// Compare a sampler with a reference distribution.
+/// </summary>
+/// <param name="name">label printed with the result</param>
+/// <param name="sample">draws from the sampler under test</param>
+/// <param name="reference">draws from the standard library distribution</param>
+/// <param name="mean">exact mean</param>
+/// <param name="variance">exact variance</param>
+/// <returns><c>true</c> if the case passes</returns>
+bool check(std::string const& name, std::function<uint32_t()> sample, std::function<uint32_t()> reference,
+    double mean, double variance)
+{
+    std::map<uint32_t, std::pair<double, double>> counts;
+    double sum = 0, sum2 = 0;
+    for (int n = 0; n < draws; ++n) {
+        auto x = sample();
+        ++counts[x].first;
+        sum += x;
+        sum2 += static_cast<double>(x) * x;
+        ++counts[reference()].second;
+    }
+
+    // Merge adjacent values until each bin holds enough draws of both kinds.
+    double chi2 = 0, a = 0, b = 0;
+    int bins = 0;
+    for (auto const& c : counts) {
+        a += c.second.first;
+        b += c.second.second;
+        if (a + b >= 20) {
+            chi2 += (a - b) * (a - b) / (a + b);
+            ++bins;
+            a = b = 0;
+        }
+    }
+    if (a + b > 0) {
+        chi2 += (a - b) * (a - b) / (a + b);
+        ++bins;
+    }
+    auto df = std::max(bins - 1, 1);
+    auto m = sum / draws;
+    auto v = sum2 / draws - m * m;
+
+    // Bounds are about five standard deviations, so a correct sampler fails rarely.
+    bool ok = chi2 < df + 5 * std::sqrt(2.0 * df)
+        && std::fabs(m - mean) < 5 * std::sqrt(variance / draws) + 1e-12
+        && std::fabs(v - variance) < 5 * variance * std::sqrt(2.0 / draws) + 0.02 * variance + 1e-12;
+    std::cout << (ok ? "pass " : "FAIL ") << name << ": chi2 " << chi2 << " on " << df
+        << " df, mean " << m << " (" << mean << "), variance " << v << " (" << variance << ")\n";
+    return ok;
+}
+
+bool binomial(uint32_t n, double p, char const* regime)
+{
+    std::mt19937_64 gen(12345), ref(67890);
+    std::binomial_distribution<uint32_t> d(n, p);
+    return check(std::string("binomial ") + regime + " n=" + std::to_string(n) + " p=" + std::to_string(p),
+        [&] { return sampleBinomial(gen, n, p); }, [&] { return d(ref); },
+        n * p, n * p * (1 - p));
+}
+
+bool poisson(double mu, char const* regime)
+{
+    std::mt19937_64 gen(424242), ref(171717);
+    std::poisson_distribution<uint32_t> d(mu);
+    return check(std::string("poisson ") + regime + " mu=" + std::to_string(mu),
+        [&] { return samplePoisson(gen, mu); }, [&] { return d(ref); },
+        mu, mu);
+}
+
+/// <summary>
+/// Check the batched Poisson sampler on lanes whose means alternate between two values.
+/// </summary>
+bool poissonBatch(double mu, double other)
+{
+    std::mt19937_64 gen(314159), ref(271828);
+    std::poisson_distribution<uint32_t> d(mu);
+    std::vector<float> means(200);
+    for (size_t l = 0; l < means.size(); ++l) means[l] = static_cast<float>(l % 2 ? other : mu);
+    std::vector<uint32_t> out(means.size());
+    size_t next = out.size();
+    return check("poisson batch mu=" + std::to_string(mu) + " beside " + std::to_string(other),
+        [&] {
+            if (next >= out.size()) {
+                samplePoissonBatch(gen, means.data(), out.data(), means.size());
+                next = 0;
+            }
+            auto x = out[next];
+            next += 2;
+            return x;
+        },
+        [&] { return d(ref); }, mu, mu);
+}
+
+bool logFactorials()
+{
+    double worst = 0;
+    for (double k = 0; k < 100000; k += k < 1000 ? 1 : 37) {
+        auto exact = std::lgamma(k + 1);
+        worst = std::max(worst, std::fabs(logFactorial(k) - exact) / std::max(1.0, exact));
+    }
+    bool ok = worst < 1e-13;
+    std::cout << (ok ? "pass " : "FAIL ") << "logFactorial: relative error " << worst << "\n";
+    return ok;
+}
+
+}
+
+int main()
+{
+    bool ok = logFactorials();
+    ok &= binomial(20, 0.3, "BINV");
+    ok &= binomial(200, 0.01, "BINV");
+    ok &= binomial(1000, 0.3, "BTRS");
+    ok &= binomial(5000, 0.02, "BTRS");
+    ok &= binomial(1000, 0.9, "BTRS (reflected)");
+    ok &= poisson(0.5, "inversion");
+    ok &= poisson(9.5, "inversion");
+    ok &= poisson(10, "PTRS");
+    ok &= poisson(250, "PTRS");
+    ok &= poissonBatch(0.3, 7.5);
+    ok &= poissonBatch(4.25, 40);
+    ok &= poissonBatch(18.5, 2);
+    return ok ? 0 : 1;
+}